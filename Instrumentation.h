@@ -0,0 +1,257 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+//
+// Counters and timers for the routing layer. They are compiled out unless
+// SOCIAL_TIE_INSTRUMENT is defined, e.g.
+//
+// CXXFLAGS="-DSOCIAL_TIE_INSTRUMENT" ./waf configure
+//
+// and then cost nothing: every INSTR_ macro expands to an empty statement.
+// Compiled in, counters are kept per node and summed up when dumped, a timer
+// only reads the cycle counter on one call in INSTR_TIMER_SAMPLE, and the
+// encounter list sizes go to a histogram with power of two buckets. Dump
+// writes everything as one JSON object.
+//
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <ostream>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+namespace ns3 {
+
+enum InstrCounter
+{
+  RECEIVE_HELLO = 0, //packets ReceivePacket dispatched, by type
+  RECEIVE_MESSAGE,
+  RECEIVE_KEY,
+  RECEIVE_FORWARD,
+  FORWARD_DECISIONS, //calculateMaxScore calls
+  FORWARD_CALLS, //decisions that forwarded
+  FORWARD_RECIPIENTS, //next hops summed over the forwards
+  SEND_HELLO,
+  SEND_MESSAGE,
+  SEND_KEY,
+  SEND_FORWARD,
+  COUNTER_COUNT
+};
+
+enum InstrTimer
+{
+  TIME_RECEIVE = 0, //one received packet, from header to handler return
+  TIME_MAX_SCORE,
+  TIME_ANONYMITY,
+  TIME_SEND,
+  TIMER_COUNT
+};
+
+static const uint32_t INSTR_TIMER_SAMPLE = 16; //every 16th call of a timer is measured
+static const uint32_t INSTR_SIZE_BUCKETS = 33; //0, then [2^(k-1), 2^k) up to 2^32
+
+static const char * const INSTR_COUNTER_NAMES[COUNTER_COUNT] = {
+  "receiveHello", "receiveMessage", "receiveKey", "receiveForward", "forwardDecisions",
+  "forwardCalls", "forwardRecipients", "sendHello", "sendMessage", "sendKey", "sendForward"
+};
+
+static const char * const INSTR_TIMER_NAMES[TIMER_COUNT] = {
+  "receivePacket", "calculateMaxScore", "nodeAnonymity", "send"
+};
+
+//cycles on x86, nanoseconds elsewhere
+static inline uint64_t
+ReadCycles ()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc ();
+#else
+  struct timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+/*
+* Instrumentation is the one set of counters of a process. Nodes are the
+* indices of the per node counters; SetNodeCount sizes them up front so that
+* counting never allocates.
+*/
+class Instrumentation
+{
+public:
+  static Instrumentation& Get ();
+  void SetNodeCount (uint32_t nodeCount);
+  void Count (InstrCounter counter, uint32_t node, uint64_t n);
+  bool Sample (InstrTimer timer);
+  void AddTime (InstrTimer timer, uint64_t cycles);
+  void AddSize (uint32_t size);
+  void Dump (std::ostream &out);
+private:
+  Instrumentation ();
+  struct Timer
+  {
+    uint64_t calls;
+    uint64_t sampled;
+    uint64_t total; //cycles over the sampled calls
+    uint64_t max;
+  };
+  std::vector<uint64_t> counters[COUNTER_COUNT]; //per node
+  Timer timers[TIMER_COUNT];
+  uint64_t sizes[INSTR_SIZE_BUCKETS];
+};
+
+inline Instrumentation::Instrumentation ()
+{
+  for (uint32_t t = 0; t < TIMER_COUNT; t++)
+  {
+    timers[t].calls = 0;
+    timers[t].sampled = 0;
+    timers[t].total = 0;
+    timers[t].max = 0;
+  }
+  for (uint32_t b = 0; b < INSTR_SIZE_BUCKETS; b++)
+    sizes[b] = 0;
+}
+
+inline Instrumentation&
+Instrumentation::Get ()
+{
+  static Instrumentation instance;
+  return instance;
+}
+
+inline void
+Instrumentation::SetNodeCount (uint32_t nodeCount)
+{
+  for (uint32_t c = 0; c < COUNTER_COUNT; c++)
+    if (counters[c].size () < nodeCount)
+      counters[c].resize (nodeCount, 0);
+}
+
+inline void
+Instrumentation::Count (InstrCounter counter, uint32_t node, uint64_t n)
+{
+  if (node >= counters[counter].size ())
+    SetNodeCount (node + 1);
+  counters[counter][node] += n;
+}
+
+//true for the calls that should be timed
+inline bool
+Instrumentation::Sample (InstrTimer timer)
+{
+  return timers[timer].calls++ % INSTR_TIMER_SAMPLE == 0;
+}
+
+inline void
+Instrumentation::AddTime (InstrTimer timer, uint64_t cycles)
+{
+  timers[timer].sampled++;
+  timers[timer].total += cycles;
+  if (cycles > timers[timer].max)
+    timers[timer].max = cycles;
+}
+
+inline void
+Instrumentation::AddSize (uint32_t size)
+{
+  uint32_t bucket = 0;
+  while (size > 0)
+  {
+    bucket++;
+    size >>= 1;
+  }
+  sizes[bucket]++;
+}
+
+inline void
+Instrumentation::Dump (std::ostream &out)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  out << "{\n  \"timerUnit\": \"cycles\",\n  \"timerSample\": " << INSTR_TIMER_SAMPLE << ",\n";
+#else
+  out << "{\n  \"timerUnit\": \"ns\",\n  \"timerSample\": " << INSTR_TIMER_SAMPLE << ",\n";
+#endif
+  out << "  \"counters\": {\n";
+  for (uint32_t c = 0; c < COUNTER_COUNT; c++)
+  {
+    uint64_t total = 0;
+    for (uint32_t n = 0; n < counters[c].size (); n++)
+      total += counters[c][n];
+    out << "    \"" << INSTR_COUNTER_NAMES[c] << "\": { \"total\": " << total << ", \"perNode\": [";
+    for (uint32_t n = 0; n < counters[c].size (); n++)
+      out << (n > 0 ? "," : "") << counters[c][n];
+    out << "] }" << (c + 1 < COUNTER_COUNT ? "," : "") << "\n";
+  }
+  out << "  },\n  \"timers\": {\n";
+  for (uint32_t t = 0; t < TIMER_COUNT; t++)
+  {
+    const Timer &timer = timers[t];
+    out << "    \"" << INSTR_TIMER_NAMES[t] << "\": { \"calls\": " << timer.calls << ", \"sampled\": " << timer.sampled
+        << ", \"total\": " << timer.total << ", \"mean\": " << (timer.sampled > 0 ? timer.total / (double) timer.sampled : 0)
+        << ", \"max\": " << timer.max << " }" << (t + 1 < TIMER_COUNT ? "," : "") << "\n";
+  }
+  //bucket k holds the sizes below 2^k; trailing empty buckets are left out
+  uint32_t used = INSTR_SIZE_BUCKETS;
+  while (used > 1 && sizes[used - 1] == 0)
+    used--;
+  out << "  },\n  \"encounterListSizes\": { \"bucketBelow\": [";
+  for (uint32_t b = 0; b < used; b++)
+    out << (b > 0 ? "," : "") << (b == 0 ? 1 : (uint64_t) 1 << b);
+  out << "], \"count\": [";
+  for (uint32_t b = 0; b < used; b++)
+    out << (b > 0 ? "," : "") << sizes[b];
+  out << "] }\n}\n";
+}
+
+/*
+* InstrTimerScope times the rest of the block it is declared in, if the
+* timer samples this call.
+*/
+class InstrTimerScope
+{
+public:
+  InstrTimerScope (InstrTimer timer);
+  ~InstrTimerScope ();
+private:
+  InstrTimer timer;
+  bool sampled;
+  uint64_t start;
+};
+
+inline InstrTimerScope::InstrTimerScope (InstrTimer timer)
+{
+  this -> timer = timer;
+  this -> sampled = Instrumentation::Get ().Sample (timer);
+  this -> start = sampled ? ReadCycles () : 0;
+}
+
+inline InstrTimerScope::~InstrTimerScope ()
+{
+  if (sampled)
+    Instrumentation::Get ().AddTime (timer, ReadCycles () - start);
+}
+
+} //namespace ns3
+
+#ifdef SOCIAL_TIE_INSTRUMENT
+#define INSTR_NODES(nodeCount) ns3::Instrumentation::Get ().SetNodeCount (nodeCount)
+#define INSTR_COUNT(counter, node) ns3::Instrumentation::Get ().Count (counter, node, 1)
+#define INSTR_ADD(counter, node, n) ns3::Instrumentation::Get ().Count (counter, node, n)
+#define INSTR_TIME(timer) ns3::InstrTimerScope instrTimerScope (timer)
+#define INSTR_SIZE(size) ns3::Instrumentation::Get ().AddSize (size)
+#else
+#define INSTR_NODES(nodeCount) do {} while (0)
+#define INSTR_COUNT(counter, node) do {} while (0)
+#define INSTR_ADD(counter, node, n) do {} while (0)
+#define INSTR_TIME(timer) do {} while (0)
+#define INSTR_SIZE(size) do {} while (0)
+#endif
+
+#endif /*INSTRUMENTATION_H*/
@@ -0,0 +1,304 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+#ifndef METRICS_H
+#define METRICS_H
+
+//
+// The results of a run, collected while it runs and written once at the
+// end: when every message was first sent, when its key went out and when it
+// was first decoded, how many forwards each node made, and the delivery
+// latencies in a log bucketed histogram. Nothing is printed on the way.
+//
+
+#include "ns3/core-module.h"
+#include "ns3/nstime.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <ostream>
+
+namespace ns3 {
+
+/*
+* LatencyHistogram counts values in buckets the way an HDR histogram does:
+* values below 2 * LATENCY_SUB_BUCKETS have a bucket each, above that every
+* power of two is split into LATENCY_SUB_BUCKETS linear buckets. A
+* percentile is the highest value of its bucket, so it is never reported
+* low and is off by at most 1 / LATENCY_SUB_BUCKETS (about 3%). The maximum
+* and the mean are exact.
+*/
+static const uint32_t LATENCY_SUB_BITS = 5;
+static const uint32_t LATENCY_SUB_BUCKETS = 1 << LATENCY_SUB_BITS;
+
+class LatencyHistogram
+{
+public:
+  LatencyHistogram();
+  void Record(uint64_t value);
+  uint64_t GetCount();
+  uint64_t GetMax();
+  double GetMean();
+  uint64_t GetPercentile(double percentile);
+private:
+  static uint32_t BucketOf(uint64_t value);
+  static uint64_t HighestIn(uint32_t bucket);
+  std::vector<uint64_t> counts; //grows to the highest bucket used
+  uint64_t count;
+  uint64_t max;
+  double total;
+};
+
+inline LatencyHistogram::LatencyHistogram()
+{
+  this -> count = 0;
+  this -> max = 0;
+  this -> total = 0;
+}
+
+inline uint32_t
+LatencyHistogram::BucketOf(uint64_t value)
+{
+  if (value < 2 * LATENCY_SUB_BUCKETS)
+    return value;
+  uint32_t top = 63;
+  while (!(value >> top))
+    top--;
+  uint32_t shift = top - LATENCY_SUB_BITS;
+  return shift * LATENCY_SUB_BUCKETS + (value >> shift);
+}
+
+inline uint64_t
+LatencyHistogram::HighestIn(uint32_t bucket)
+{
+  if (bucket < 2 * LATENCY_SUB_BUCKETS)
+    return bucket;
+  uint32_t shift = bucket / LATENCY_SUB_BUCKETS - 1;
+  uint64_t sub = bucket - shift * LATENCY_SUB_BUCKETS;
+  return ((sub + 1) << shift) - 1;
+}
+
+inline void
+LatencyHistogram::Record(uint64_t value)
+{
+  uint32_t bucket = BucketOf(value);
+  if (bucket >= counts.size())
+    counts.resize(bucket + 1, 0);
+  counts[bucket]++;
+  count++;
+  total += value;
+  if (value > max)
+    max = value;
+}
+
+inline uint64_t
+LatencyHistogram::GetCount()
+{
+  return this -> count;
+}
+
+inline uint64_t
+LatencyHistogram::GetMax()
+{
+  return this -> max;
+}
+
+inline double
+LatencyHistogram::GetMean()
+{
+  return count > 0 ? total / count : 0;
+}
+
+//the smallest recorded value at or above the given share (0 to 100) of the values, 0 if there are none
+inline uint64_t
+LatencyHistogram::GetPercentile(double percentile)
+{
+  if (count == 0)
+    return 0;
+  uint64_t rank = (uint64_t) (percentile / 100.0 * count + 0.5);
+  rank = std::max(rank, (uint64_t) 1);
+  uint64_t seen = 0;
+  for (uint32_t bucket = 0; bucket < counts.size(); bucket++)
+  {
+    seen += counts[bucket];
+    if (seen >= rank)
+      return std::min(HighestIn(bucket), max);
+  }
+  return max;
+}
+
+/*
+* MetricsCollector holds the results of one run. Messages are indexed by
+* their key number. Latency is from a message's first send to its first
+* decode, in microseconds. The delivery ratio over time counts the messages
+* decoded by then against the keys sent by then, like the final ratio.
+*/
+class MetricsCollector
+{
+public:
+  MetricsCollector();
+  void SetNodeCount(uint32_t nodeCount);
+  void MessageSent(uint32_t key, Time t);
+  void KeySent(uint32_t key, Time t);
+  bool Delivered(uint32_t key, Time t);
+  void Forwarded(uint32_t node);
+  LatencyHistogram& GetLatency();
+  void WriteJson(std::ostream &out, Time start, Time end, Time step);
+  void WriteCsv(std::ostream &out, Time start, Time end, Time step);
+  bool Write(const std::string &fileName, Time start, Time end, Time step);
+private:
+  static void Mark(std::vector<int64_t> &times, uint32_t key, Time t);
+  void DeliveryOverTime(Time start, Time end, Time step, std::vector<uint64_t> &sent, std::vector<uint64_t> &delivered);
+  std::vector<int64_t> messageSent; //nanoseconds by key, -1 until it happens
+  std::vector<int64_t> keySent;
+  std::vector<int64_t> delivered;
+  std::vector<uint64_t> forwards; //per node
+  LatencyHistogram latency;
+};
+
+inline MetricsCollector::MetricsCollector()
+{
+}
+
+inline void
+MetricsCollector::SetNodeCount(uint32_t nodeCount)
+{
+  this -> forwards.assign(nodeCount, 0);
+}
+
+//only the first time of each key is kept
+inline void
+MetricsCollector::Mark(std::vector<int64_t> &times, uint32_t key, Time t)
+{
+  if (key >= times.size())
+    times.resize(key + 1, -1);
+  if (times[key] < 0)
+    times[key] = t.GetNanoSeconds();
+}
+
+inline void
+MetricsCollector::MessageSent(uint32_t key, Time t)
+{
+  Mark(messageSent, key, t);
+}
+
+inline void
+MetricsCollector::KeySent(uint32_t key, Time t)
+{
+  Mark(keySent, key, t);
+}
+
+//returns true for the first decode of the message
+inline bool
+MetricsCollector::Delivered(uint32_t key, Time t)
+{
+  if (key < delivered.size() && delivered[key] >= 0)
+    return false;
+  Mark(delivered, key, t);
+  if (key < messageSent.size() && messageSent[key] >= 0)
+    latency.Record((t.GetNanoSeconds() - messageSent[key]) / 1000);
+  return true;
+}
+
+inline void
+MetricsCollector::Forwarded(uint32_t node)
+{
+  if (node >= forwards.size())
+    forwards.resize(node + 1, 0);
+  forwards[node]++;
+}
+
+inline LatencyHistogram&
+MetricsCollector::GetLatency()
+{
+  return this -> latency;
+}
+
+//keys sent and messages delivered by start + step, start + 2 step, ... up to end
+inline void
+MetricsCollector::DeliveryOverTime(Time start, Time end, Time step, std::vector<uint64_t> &sent, std::vector<uint64_t> &decoded)
+{
+  std::vector<int64_t> sentTimes;
+  std::vector<int64_t> decodedTimes;
+  for (uint32_t key = 0; key < keySent.size(); key++)
+    if (keySent[key] >= 0)
+      sentTimes.push_back(keySent[key]);
+  for (uint32_t key = 0; key < delivered.size(); key++)
+    if (delivered[key] >= 0)
+      decodedTimes.push_back(delivered[key]);
+  std::sort(sentTimes.begin(), sentTimes.end());
+  std::sort(decodedTimes.begin(), decodedTimes.end());
+  uint32_t s = 0;
+  uint32_t d = 0;
+  for (int64_t t = (start + step).GetNanoSeconds(); step.IsStrictlyPositive() && t <= end.GetNanoSeconds(); t += step.GetNanoSeconds())
+  {
+    while (s < sentTimes.size() && sentTimes[s] <= t)
+      s++;
+    while (d < decodedTimes.size() && decodedTimes[d] <= t)
+      d++;
+    sent.push_back(s);
+    decoded.push_back(d);
+  }
+}
+
+inline void
+MetricsCollector::WriteJson(std::ostream &out, Time start, Time end, Time step)
+{
+  out << "{\n  \"latencyMs\": { \"count\": " << latency.GetCount() << ", \"mean\": " << latency.GetMean() / 1000.0
+      << ", \"p50\": " << latency.GetPercentile(50) / 1000.0 << ", \"p90\": " << latency.GetPercentile(90) / 1000.0
+      << ", \"p99\": " << latency.GetPercentile(99) / 1000.0 << ", \"max\": " << latency.GetMax() / 1000.0 << " },\n";
+  out << "  \"forwardsPerNode\": [";
+  for (uint32_t n = 0; n < forwards.size(); n++)
+    out << (n > 0 ? "," : "") << forwards[n];
+  std::vector<uint64_t> sent;
+  std::vector<uint64_t> decoded;
+  DeliveryOverTime(start, end, step, sent, decoded);
+  out << "],\n  \"deliveryOverTime\": [";
+  for (uint32_t i = 0; i < sent.size(); i++)
+  {
+    out << (i > 0 ? "," : "") << "\n    { \"timeS\": " << (step * (double) (i + 1)).GetSeconds() << ", \"sent\": " << sent[i]
+        << ", \"decoded\": " << decoded[i] << ", \"ratio\": " << (sent[i] > 0 ? decoded[i] / (double) sent[i] : 0) << " }";
+  }
+  out << "\n  ]\n}\n";
+}
+
+//one long table: metric, index (percentile, node or seconds) and value
+inline void
+MetricsCollector::WriteCsv(std::ostream &out, Time start, Time end, Time step)
+{
+  out << "metric,index,value\n";
+  out << "latencyMs,count," << latency.GetCount() << "\n";
+  out << "latencyMs,mean," << latency.GetMean() / 1000.0 << "\n";
+  out << "latencyMs,p50," << latency.GetPercentile(50) / 1000.0 << "\n";
+  out << "latencyMs,p90," << latency.GetPercentile(90) / 1000.0 << "\n";
+  out << "latencyMs,p99," << latency.GetPercentile(99) / 1000.0 << "\n";
+  out << "latencyMs,max," << latency.GetMax() / 1000.0 << "\n";
+  for (uint32_t n = 0; n < forwards.size(); n++)
+    out << "forwards," << n << "," << forwards[n] << "\n";
+  std::vector<uint64_t> sent;
+  std::vector<uint64_t> decoded;
+  DeliveryOverTime(start, end, step, sent, decoded);
+  for (uint32_t i = 0; i < sent.size(); i++)
+  {
+    double t = (step * (double) (i + 1)).GetSeconds();
+    out << "sent," << t << "," << sent[i] << "\n";
+    out << "decoded," << t << "," << decoded[i] << "\n";
+    out << "deliveryRatio," << t << "," << (sent[i] > 0 ? decoded[i] / (double) sent[i] : 0) << "\n";
+  }
+}
+
+//CSV if the name ends in .csv, JSON otherwise; times are taken from start
+inline bool
+MetricsCollector::Write(const std::string &fileName, Time start, Time end, Time step)
+{
+  std::ofstream out (fileName.c_str());
+  if (fileName.size() > 4 && fileName.compare(fileName.size() - 4, 4, ".csv") == 0)
+    WriteCsv(out, start, end, step);
+  else
+    WriteJson(out, start, end, step);
+  return out.good();
+}
+
+} //namespace ns3
+
+#endif /*METRICS_H*/
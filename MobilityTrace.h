@@ -0,0 +1,424 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+#ifndef MOBILITYTRACE_H
+#define MOBILITYTRACE_H
+
+//
+// A compact binary format for mobility and contact traces, its writer, an
+// mmap based reader and a player that drives mobility models from a trace.
+//
+// A file is a TraceFileHeader followed by fixed size records of one kind,
+// in host byte order. Waypoint records hold a node's course change: its
+// position and velocity from then on. Contact records hold a pair of nodes
+// in range of each other from a start to an end time. Records are sorted by
+// time and every record stores its time as the microseconds since the record
+// before it. A waypoint stores its position as the millimeters it moved since
+// the node's previous waypoint. Times and positions are rounded before the
+// deltas are taken, so decoding adds no error of its own.
+//
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace ns3 {
+
+static const char TRACE_MAGIC[4] = { 'S', 'A', 'T', 'R' };
+static const uint16_t TRACE_VERSION = 2; //version 1 had 32-bit times
+
+struct TraceFileHeader
+{
+  char magic[4];
+  uint16_t version;
+  uint16_t kind; //TraceWriter::WAYPOINTS or TraceWriter::CONTACTS
+  uint32_t nodeCount;
+  uint32_t reserved;
+  uint64_t recordCount;
+};
+
+struct WaypointRecord
+{
+  uint64_t dt; //microseconds since the previous record
+  uint32_t node;
+  int32_t dx; //millimeters since the node's previous waypoint
+  int32_t dy;
+  int32_t vx; //millimeters per second
+  int32_t vy;
+};
+
+struct ContactRecord
+{
+  uint64_t dt; //microseconds from the previous contact's start to this one's
+  uint64_t duration; //microseconds
+  uint32_t a;
+  uint32_t b;
+};
+
+static inline int64_t
+TraceMicros (Time t)
+{
+  return (t.GetNanoSeconds () + 500) / 1000;
+}
+
+static inline int32_t
+TraceMillis (double meters)
+{
+  return (int32_t) floor (meters * 1000 + 0.5);
+}
+
+/*
+* TraceWriter writes one trace file. Records must come in time order;
+* AddWaypoint and AddContact write nothing and return false for a record that
+* does not. The record count in the header is filled in by Close.
+*/
+class TraceWriter
+{
+public:
+  enum Kind { WAYPOINTS = 1, CONTACTS = 2 };
+  TraceWriter ();
+  ~TraceWriter ();
+  bool Open (const std::string &fileName, uint16_t kind, uint32_t nodeCount);
+  bool AddWaypoint (uint32_t node, Time t, Vector position, Vector velocity);
+  bool AddContact (uint32_t a, uint32_t b, Time start, Time end);
+  void Capture (NodeContainer nodes);
+  void CourseChanged (Ptr<const MobilityModel> mobility);
+  bool Close ();
+private:
+  bool Delta (Time t, uint64_t &dt);
+  FILE *file;
+  TraceFileHeader header;
+  int64_t lastTime; //microseconds
+  std::vector<int32_t> lastX; //millimeters, per node
+  std::vector<int32_t> lastY;
+};
+
+inline TraceWriter::TraceWriter ()
+{
+  this -> file = NULL;
+}
+
+inline TraceWriter::~TraceWriter ()
+{
+  Close ();
+}
+
+inline bool
+TraceWriter::Open (const std::string &fileName, uint16_t kind, uint32_t nodeCount)
+{
+  this -> file = fopen (fileName.c_str (), "wb");
+  if (file == NULL)
+    return false;
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, TRACE_MAGIC, sizeof (header.magic));
+  header.version = TRACE_VERSION;
+  header.kind = kind;
+  header.nodeCount = nodeCount;
+  this -> lastTime = 0;
+  this -> lastX.assign (nodeCount, 0);
+  this -> lastY.assign (nodeCount, 0);
+  return fwrite (&header, sizeof (header), 1, file) == 1;
+}
+
+//false if t comes before the previous record
+inline bool
+TraceWriter::Delta (Time t, uint64_t &dt)
+{
+  int64_t now = TraceMicros (t);
+  if (now < lastTime)
+    return false;
+  dt = (uint64_t) (now - lastTime);
+  this -> lastTime = now;
+  return true;
+}
+
+inline bool
+TraceWriter::AddWaypoint (uint32_t node, Time t, Vector position, Vector velocity)
+{
+  NS_ASSERT (header.kind == WAYPOINTS);
+  WaypointRecord record;
+  memset (&record, 0, sizeof (record));
+  if (node >= header.nodeCount || !Delta (t, record.dt))
+    return false;
+  record.node = node;
+  int32_t x = TraceMillis (position.x);
+  int32_t y = TraceMillis (position.y);
+  record.dx = x - lastX[node];
+  record.dy = y - lastY[node];
+  record.vx = TraceMillis (velocity.x);
+  record.vy = TraceMillis (velocity.y);
+  lastX[node] = x;
+  lastY[node] = y;
+  fwrite (&record, sizeof (record), 1, file);
+  header.recordCount++;
+  return true;
+}
+
+//contacts must come sorted by their start
+inline bool
+TraceWriter::AddContact (uint32_t a, uint32_t b, Time start, Time end)
+{
+  NS_ASSERT (header.kind == CONTACTS);
+  ContactRecord record;
+  memset (&record, 0, sizeof (record));
+  if (TraceMicros (end) < TraceMicros (start) || !Delta (start, record.dt))
+    return false;
+  record.a = a;
+  record.b = b;
+  record.duration = (uint64_t) (TraceMicros (end) - TraceMicros (start));
+  fwrite (&record, sizeof (record), 1, file);
+  header.recordCount++;
+  return true;
+}
+
+//record where every node is now and follow its course changes from here on
+inline void
+TraceWriter::Capture (NodeContainer nodes)
+{
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+  {
+    Ptr<MobilityModel> mobility = nodes.Get (i) -> GetObject<MobilityModel> ();
+    AddWaypoint (nodes.Get (i) -> GetId (), Simulator::Now (), mobility -> GetPosition (), mobility -> GetVelocity ());
+    mobility -> TraceConnectWithoutContext ("CourseChange", MakeCallback (&TraceWriter::CourseChanged, this));
+  }
+}
+
+inline void
+TraceWriter::CourseChanged (Ptr<const MobilityModel> mobility)
+{
+  if (file != NULL)
+    AddWaypoint (mobility -> GetObject<Node> () -> GetId (), Simulator::Now (), mobility -> GetPosition (), mobility -> GetVelocity ());
+}
+
+inline bool
+TraceWriter::Close ()
+{
+  if (file == NULL)
+    return true;
+  bool ok = fseek (file, 0, SEEK_SET) == 0 && fwrite (&header, sizeof (header), 1, file) == 1;
+  ok = fclose (file) == 0 && ok;
+  this -> file = NULL;
+  return ok;
+}
+
+/*
+* TraceReader maps a trace file and hands out its records in place, so
+* opening a trace costs the same however large it is.
+*/
+class TraceReader
+{
+public:
+  TraceReader ();
+  ~TraceReader ();
+  bool Open (const std::string &fileName);
+  static bool IsTrace (const std::string &fileName);
+  uint16_t GetKind () const;
+  uint32_t GetNodeCount () const;
+  uint64_t GetRecordCount () const;
+  double GetMaxSpeed () const;
+  const WaypointRecord* GetWaypoints () const;
+  const ContactRecord* GetContacts () const;
+private:
+  TraceReader (const TraceReader &);
+  TraceReader &operator= (const TraceReader &);
+  void *map;
+  size_t size;
+  const TraceFileHeader *header;
+};
+
+inline TraceReader::TraceReader ()
+{
+  this -> map = MAP_FAILED;
+  this -> size = 0;
+  this -> header = NULL;
+}
+
+inline TraceReader::~TraceReader ()
+{
+  if (map != MAP_FAILED)
+    munmap (map, size);
+}
+
+inline bool
+TraceReader::Open (const std::string &fileName)
+{
+  int fd = open (fileName.c_str (), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat info;
+  if (fstat (fd, &info) < 0 || (size_t) info.st_size < sizeof (TraceFileHeader))
+  {
+    close (fd);
+    return false;
+  }
+  this -> size = info.st_size;
+  this -> map = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    return false;
+  this -> header = (const TraceFileHeader *) map;
+  size_t recordSize = header -> kind == TraceWriter::WAYPOINTS ? sizeof (WaypointRecord) : sizeof (ContactRecord);
+  if (memcmp (header -> magic, TRACE_MAGIC, sizeof (header -> magic)) != 0 || header -> version != TRACE_VERSION ||
+      (header -> kind != TraceWriter::WAYPOINTS && header -> kind != TraceWriter::CONTACTS) ||
+      (size - sizeof (TraceFileHeader)) / recordSize < header -> recordCount)
+    return false;
+  madvise (map, size, MADV_SEQUENTIAL);
+  return true;
+}
+
+inline bool
+TraceReader::IsTrace (const std::string &fileName)
+{
+  char magic[4];
+  FILE *file = fopen (fileName.c_str (), "rb");
+  if (file == NULL)
+    return false;
+  bool isTrace = fread (magic, sizeof (magic), 1, file) == 1 && memcmp (magic, TRACE_MAGIC, sizeof (magic)) == 0;
+  fclose (file);
+  return isTrace;
+}
+
+inline uint16_t
+TraceReader::GetKind () const
+{
+  return header -> kind;
+}
+
+inline uint32_t
+TraceReader::GetNodeCount () const
+{
+  return header -> nodeCount;
+}
+
+inline uint64_t
+TraceReader::GetRecordCount () const
+{
+  return header -> recordCount;
+}
+
+//meters per second, the fastest any node of a waypoint trace moves
+inline double
+TraceReader::GetMaxSpeed () const
+{
+  const WaypointRecord *records = GetWaypoints ();
+  double maxSpeed = 0;
+  for (uint64_t i = 0; i < header -> recordCount; i++)
+  {
+    double speed = sqrt ((double) records[i].vx * records[i].vx + (double) records[i].vy * records[i].vy) / 1000;
+    maxSpeed = std::max (maxSpeed, speed);
+  }
+  return maxSpeed;
+}
+
+inline const WaypointRecord*
+TraceReader::GetWaypoints () const
+{
+  return (const WaypointRecord *) (header + 1);
+}
+
+inline const ContactRecord*
+TraceReader::GetContacts () const
+{
+  return (const ContactRecord *) (header + 1);
+}
+
+/*
+* TraceMobilityPlayer drives a ConstantVelocityMobilityModel on every node
+* from a waypoint trace: at each waypoint the node jumps to the recorded
+* position and moves on at the recorded velocity. It walks the mapped records
+* in order with one pending event, so a trace of any length plays in constant
+* memory.
+*/
+class TraceMobilityPlayer
+{
+public:
+  TraceMobilityPlayer (const TraceReader &reader, NodeContainer nodes);
+  void Start ();
+  void Restart ();
+private:
+  void Apply ();
+  EventId pending;
+  const WaypointRecord *records;
+  uint64_t count;
+  uint64_t next; //the first record not applied yet
+  int64_t nextTime; //microseconds
+  std::vector<int32_t> x; //millimeters, per node
+  std::vector<int32_t> y;
+  std::vector<Ptr<ConstantVelocityMobilityModel> > models;
+};
+
+inline TraceMobilityPlayer::TraceMobilityPlayer (const TraceReader &reader, NodeContainer nodes)
+{
+  this -> records = reader.GetWaypoints ();
+  this -> count = reader.GetRecordCount ();
+  this -> next = 0;
+  this -> nextTime = count > 0 ? records[0].dt : 0;
+  this -> x.assign (reader.GetNodeCount (), 0);
+  this -> y.assign (reader.GetNodeCount (), 0);
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+  {
+    Ptr<ConstantVelocityMobilityModel> model = nodes.Get (i) -> GetObject<ConstantVelocityMobilityModel> ();
+    NS_ASSERT_MSG (model, "a trace plays on ConstantVelocityMobilityModel nodes");
+    models.push_back (model);
+  }
+}
+
+//the records at time zero are applied right away, so positions are set before the simulation starts
+inline void
+TraceMobilityPlayer::Start ()
+{
+  if (next < count && nextTime <= TraceMicros (Simulator::Now ()))
+    Apply ();
+  else if (next < count)
+    pending = Simulator::Schedule (MicroSeconds (nextTime) - Simulator::Now (), &TraceMobilityPlayer::Apply, this);
+}
+
+//play the trace again from its start, which is now
+inline void
+TraceMobilityPlayer::Restart ()
+{
+  Simulator::Cancel (pending);
+  this -> next = 0;
+  this -> nextTime = count > 0 ? records[0].dt + TraceMicros (Simulator::Now ()) : 0;
+  this -> x.assign (x.size (), 0);
+  this -> y.assign (y.size (), 0);
+  Start ();
+}
+
+inline void
+TraceMobilityPlayer::Apply ()
+{
+  int64_t now = nextTime;
+  while (next < count && nextTime == now)
+  {
+    const WaypointRecord &record = records[next];
+    if (record.node < x.size ())
+    {
+      x[record.node] += record.dx;
+      y[record.node] += record.dy;
+    }
+    if (record.node < x.size () && record.node < models.size ())
+    {
+      models[record.node] -> SetPosition (Vector (x[record.node] / 1000.0, y[record.node] / 1000.0, 0));
+      models[record.node] -> SetVelocity (Vector (record.vx / 1000.0, record.vy / 1000.0, 0));
+    }
+    next++;
+    if (next < count)
+      nextTime += records[next].dt;
+  }
+  if (next < count)
+    pending = Simulator::Schedule (MicroSeconds (nextTime - now), &TraceMobilityPlayer::Apply, this);
+}
+
+} //namespace ns3
+
+#endif /*MOBILITYTRACE_H*/
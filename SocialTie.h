@@ -0,0 +1,1109 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+#ifndef SOCIALTIE_H
+#define SOCIALTIE_H
+
+//
+// The social tie state every node keeps: the encounters it has had and the
+// scores they add up to, the message and key halves waiting for each other,
+// the packets it has already forwarded and which keys were decoded.
+// simple-adhoc.cc feeds it from hello, message and key packets;
+// social-tie-trace.cc feeds it straight from a contact trace.
+// The state can be saved to and loaded from a SnapshotBuffer, so a run can
+// start from the social ties another run has built up.
+//
+
+#include "ns3/core-module.h"
+#include "ns3/nstime.h"
+#include <stdint.h>
+#include <vector>
+#include <math.h>
+#include <algorithm>
+#include <string.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace ns3 {
+
+/*
+* SnapshotBuffer is the byte buffer the social tie state is saved to. Values
+* are copied in as raw bytes in host byte order; Get fails, and keeps
+* failing, once a read runs past the end.
+*/
+class SnapshotBuffer
+{
+public:
+  SnapshotBuffer();
+  template <typename T> void Put(const T &value);
+  template <typename T> bool Get(T &value);
+  std::vector<uint8_t>& GetData();
+  bool IsGood();
+private:
+  std::vector<uint8_t> data;
+  uint32_t offset; //next byte Get reads
+  bool good;
+};
+
+inline SnapshotBuffer::SnapshotBuffer()
+{
+  this -> offset = 0;
+  this -> good = true;
+}
+
+template <typename T>
+inline void
+SnapshotBuffer::Put(const T &value)
+{
+  const uint8_t *bytes = (const uint8_t *) &value;
+  data.insert(data.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+inline bool
+SnapshotBuffer::Get(T &value)
+{
+  if (!good || offset + sizeof(T) > data.size())
+  {
+    good = false;
+    return false;
+  }
+  memcpy(&value, &data[offset], sizeof(T));
+  offset += sizeof(T);
+  return true;
+}
+
+inline std::vector<uint8_t>&
+SnapshotBuffer::GetData()
+{
+  return this -> data;
+}
+
+inline bool
+SnapshotBuffer::IsGood()
+{
+  return this -> good;
+}
+
+/*
+* DecodeAccounting records which message keys have been decoded, by malicious
+* nodes, by good nodes and by anyone. Each view is a bitset indexed by key
+* with a running count, so a lookup is O(1) and the totals need no rescan.
+*/
+class DecodeAccounting
+{
+public:
+  DecodeAccounting();
+  void RecordDecode(uint32_t key, bool byMalicious);
+  bool IsDecoded(uint32_t key);
+  uint32_t GetMaliciousCount();
+  uint32_t GetGoodCount();
+  uint32_t GetTotalCount();
+private:
+  static void Mark(std::vector<bool> &decoded, uint32_t &count, uint32_t key);
+  std::vector<bool> maliciousDecoded;
+  std::vector<bool> goodDecoded;
+  std::vector<bool> totalDecoded;
+  uint32_t maliciousCount;
+  uint32_t goodCount;
+  uint32_t totalCount;
+};
+
+inline DecodeAccounting::DecodeAccounting()
+{
+  this -> maliciousCount = 0;
+  this -> goodCount = 0;
+  this -> totalCount = 0;
+}
+
+inline void
+DecodeAccounting::Mark(std::vector<bool> &decoded, uint32_t &count, uint32_t key)
+{
+  if (key >= decoded.size())
+    decoded.resize(key + 1, false);
+  if (!decoded[key])
+  {
+    decoded[key] = true;
+    count++;
+  }
+}
+
+inline void
+DecodeAccounting::RecordDecode(uint32_t key, bool byMalicious)
+{
+  if (byMalicious)
+    Mark(maliciousDecoded, maliciousCount, key);
+  else
+    Mark(goodDecoded, goodCount, key);
+  Mark(totalDecoded, totalCount, key);
+}
+
+inline bool
+DecodeAccounting::IsDecoded(uint32_t key)
+{
+  return key < totalDecoded.size() && totalDecoded[key];
+}
+
+inline uint32_t
+DecodeAccounting::GetMaliciousCount()
+{
+  return this -> maliciousCount;
+}
+
+inline uint32_t
+DecodeAccounting::GetGoodCount()
+{
+  return this -> goodCount;
+}
+
+inline uint32_t
+DecodeAccounting::GetTotalCount()
+{
+  return this -> totalCount;
+}
+
+/*
+* NeighborSet holds the ids of the nodes a node currently has a score for.
+* The ids are kept in a sorted vector, so walking the set is a linear scan
+* over contiguous memory. Small networks also keep a dense bitset for O(1)
+* lookups; large ones fall back to a binary search of the vector.
+* The set is owned by its MyReceiver and refilled in place, so it only
+* allocates while it grows.
+*/
+static const int DENSE_NEIGHBOR_LIMIT = 4096; //largest network that gets the bitset
+
+class NeighborSet
+{
+public:
+  NeighborSet();
+  NeighborSet(int nodeSize);
+  void Clear();
+  void Insert(uint32_t id);
+  bool Contains(uint32_t id);
+  uint32_t GetSize();
+  uint32_t Get(uint32_t i);
+  void Save(SnapshotBuffer &buffer);
+  bool Load(SnapshotBuffer &buffer, int nodeSize);
+private:
+  std::vector<uint64_t> bits; //empty for large networks
+  std::vector<uint32_t> ids; //kept sorted
+};
+
+inline NeighborSet::NeighborSet()
+{
+}
+
+inline NeighborSet::NeighborSet(int nodeSize)
+{
+  if (nodeSize <= DENSE_NEIGHBOR_LIMIT)
+    this -> bits.resize((nodeSize + 63) / 64, 0);
+}
+
+inline void
+NeighborSet::Clear()
+{
+  if (!bits.empty())
+  {
+    for (uint32_t i = 0; i < ids.size(); i++)
+    {
+      bits[ids[i] / 64] &= ~((uint64_t) 1 << (ids[i] % 64));
+    }
+  }
+  ids.clear();
+}
+
+inline void
+NeighborSet::Insert(uint32_t id)
+{
+  if (Contains(id))
+    return;
+  if (!bits.empty())
+    bits[id / 64] |= (uint64_t) 1 << (id % 64);
+  //ids usually arrive in increasing order, which makes this a push_back
+  if (ids.empty() || ids.back() < id)
+    ids.push_back(id);
+  else
+    ids.insert(std::lower_bound(ids.begin(), ids.end(), id), id);
+}
+
+inline bool
+NeighborSet::Contains(uint32_t id)
+{
+  if (!bits.empty())
+    return (bits[id / 64] >> (id % 64)) & 1;
+  return std::binary_search(ids.begin(), ids.end(), id);
+}
+
+inline uint32_t
+NeighborSet::GetSize()
+{
+  return this -> ids.size();
+}
+
+inline uint32_t
+NeighborSet::Get(uint32_t i)
+{
+  return this -> ids[i];
+}
+
+inline void
+NeighborSet::Save(SnapshotBuffer &buffer)
+{
+  buffer.Put((uint32_t) ids.size());
+  for (uint32_t i = 0; i < ids.size(); i++)
+    buffer.Put(ids[i]);
+}
+
+inline bool
+NeighborSet::Load(SnapshotBuffer &buffer, int nodeSize)
+{
+  Clear();
+  uint32_t size = 0;
+  buffer.Get(size);
+  for (uint32_t i = 0; i < size; i++)
+  {
+    uint32_t id = 0;
+    if (!buffer.Get(id) || id >= (uint32_t) nodeSize)
+      return false;
+    Insert(id);
+  }
+  return buffer.IsGood();
+}
+
+/*mj;
+class LinkedList : public Object
+{
+public:
+  LinkedList();
+  LinkedList(int n);
+  void addNode(struct Node *head, int n);
+}
+*/
+
+
+/*
+* Batch decay kernel.
+* The social-tie weight of an encounter is factor^(lambda * dt), which is
+* evaluated here as exp2(rate * dt) with rate = lambda * log2(factor) per
+* nanosecond. exp2 is split into 2^n * 2^f with n = round(x) and
+* f in [-0.5, 0.5]; 2^f is a degree 8 Taylor polynomial whose truncation error
+* is below 3e-10 relative to pow(), and 2^n is added straight into the
+* exponent bits. The SSE2, AVX2 and scalar paths use the same polynomial, so
+* they agree to within a rounding step. Timestamps are in nanoseconds and dt
+* must stay below 2^52 ns (about 52 days of simulated time).
+*/
+static const double DECAY_MIN_EXPONENT = -1000.0; //weights below 2^-1000 are as good as gone
+static const double DECAY_ROUND_MAGIC = 6755399441055744.0; //1.5 * 2^52, rounds to nearest integer
+static const double DECAY_INT_MAGIC = 4503599627370496.0; //2^52, int64 to double for values below 2^52
+static const double DECAY_C1 = 6.9314718055994531e-01; //ln2^k / k!
+static const double DECAY_C2 = 2.4022650695910071e-01;
+static const double DECAY_C3 = 5.5504108664821580e-02;
+static const double DECAY_C4 = 9.6181291076284772e-03;
+static const double DECAY_C5 = 1.3333558146428443e-03;
+static const double DECAY_C6 = 1.5403530393381609e-04;
+static const double DECAY_C7 = 1.5252733804059841e-05;
+static const double DECAY_C8 = 1.3215486790144307e-06;
+
+inline double
+DecayRate(double factor, double lambda)
+{
+  return lambda * log (factor) / log (2.0) * 1e-9;
+}
+
+static inline double
+ScalarDecay(int64_t dt, double rate)
+{
+  double x = rate * (double) dt;
+  if (x < DECAY_MIN_EXPONENT)
+    x = DECAY_MIN_EXPONENT;
+  double n = floor (x + 0.5);
+  double f = x - n;
+  double p = DECAY_C8;
+  p = p * f + DECAY_C7;
+  p = p * f + DECAY_C6;
+  p = p * f + DECAY_C5;
+  p = p * f + DECAY_C4;
+  p = p * f + DECAY_C3;
+  p = p * f + DECAY_C2;
+  p = p * f + DECAY_C1;
+  p = p * f + 1.0;
+  uint64_t bits;
+  memcpy (&bits, &p, sizeof (bits));
+  bits += (uint64_t) (int64_t) n << 52;
+  memcpy (&p, &bits, sizeof (p));
+  return p;
+}
+
+//weights[i] = exp2(rate * (now - timestamps[i]))
+inline void
+DecayWeights(const int64_t *timestamps, uint32_t n, int64_t now, double rate, double *weights)
+{
+  uint32_t i = 0;
+#if defined(__AVX2__)
+  const __m256i nowV = _mm256_set1_epi64x (now);
+  const __m256i intMagicI = _mm256_castpd_si256 (_mm256_set1_pd (DECAY_INT_MAGIC));
+  const __m256d intMagic = _mm256_set1_pd (DECAY_INT_MAGIC);
+  const __m256d roundMagic = _mm256_set1_pd (DECAY_ROUND_MAGIC);
+  const __m256i roundMagicI = _mm256_castpd_si256 (roundMagic);
+  const __m256d rateV = _mm256_set1_pd (rate);
+  const __m256d minV = _mm256_set1_pd (DECAY_MIN_EXPONENT);
+  for (; i + 4 <= n; i += 4)
+  {
+    __m256i dt = _mm256_sub_epi64 (nowV, _mm256_loadu_si256 ((const __m256i *) (timestamps + i)));
+    __m256d dtD = _mm256_sub_pd (_mm256_castsi256_pd (_mm256_add_epi64 (dt, intMagicI)), intMagic);
+    __m256d x = _mm256_max_pd (_mm256_mul_pd (rateV, dtD), minV);
+    __m256d shifted = _mm256_add_pd (x, roundMagic);
+    __m256d f = _mm256_sub_pd (x, _mm256_sub_pd (shifted, roundMagic));
+    __m256d p = _mm256_set1_pd (DECAY_C8);
+    p = _mm256_add_pd (_mm256_mul_pd (p, f), _mm256_set1_pd (DECAY_C7));
+    p = _mm256_add_pd (_mm256_mul_pd (p, f), _mm256_set1_pd (DECAY_C6));
+    p = _mm256_add_pd (_mm256_mul_pd (p, f), _mm256_set1_pd (DECAY_C5));
+    p = _mm256_add_pd (_mm256_mul_pd (p, f), _mm256_set1_pd (DECAY_C4));
+    p = _mm256_add_pd (_mm256_mul_pd (p, f), _mm256_set1_pd (DECAY_C3));
+    p = _mm256_add_pd (_mm256_mul_pd (p, f), _mm256_set1_pd (DECAY_C2));
+    p = _mm256_add_pd (_mm256_mul_pd (p, f), _mm256_set1_pd (DECAY_C1));
+    p = _mm256_add_pd (_mm256_mul_pd (p, f), _mm256_set1_pd (1.0));
+    __m256i exponent = _mm256_slli_epi64 (_mm256_sub_epi64 (_mm256_castpd_si256 (shifted), roundMagicI), 52);
+    _mm256_storeu_pd (weights + i, _mm256_castsi256_pd (_mm256_add_epi64 (_mm256_castpd_si256 (p), exponent)));
+  }
+#elif defined(__SSE2__)
+  const __m128i nowV = _mm_set1_epi64x (now);
+  const __m128i intMagicI = _mm_castpd_si128 (_mm_set1_pd (DECAY_INT_MAGIC));
+  const __m128d intMagic = _mm_set1_pd (DECAY_INT_MAGIC);
+  const __m128d roundMagic = _mm_set1_pd (DECAY_ROUND_MAGIC);
+  const __m128i roundMagicI = _mm_castpd_si128 (roundMagic);
+  const __m128d rateV = _mm_set1_pd (rate);
+  const __m128d minV = _mm_set1_pd (DECAY_MIN_EXPONENT);
+  for (; i + 2 <= n; i += 2)
+  {
+    __m128i dt = _mm_sub_epi64 (nowV, _mm_loadu_si128 ((const __m128i *) (timestamps + i)));
+    __m128d dtD = _mm_sub_pd (_mm_castsi128_pd (_mm_add_epi64 (dt, intMagicI)), intMagic);
+    __m128d x = _mm_max_pd (_mm_mul_pd (rateV, dtD), minV);
+    __m128d shifted = _mm_add_pd (x, roundMagic);
+    __m128d f = _mm_sub_pd (x, _mm_sub_pd (shifted, roundMagic));
+    __m128d p = _mm_set1_pd (DECAY_C8);
+    p = _mm_add_pd (_mm_mul_pd (p, f), _mm_set1_pd (DECAY_C7));
+    p = _mm_add_pd (_mm_mul_pd (p, f), _mm_set1_pd (DECAY_C6));
+    p = _mm_add_pd (_mm_mul_pd (p, f), _mm_set1_pd (DECAY_C5));
+    p = _mm_add_pd (_mm_mul_pd (p, f), _mm_set1_pd (DECAY_C4));
+    p = _mm_add_pd (_mm_mul_pd (p, f), _mm_set1_pd (DECAY_C3));
+    p = _mm_add_pd (_mm_mul_pd (p, f), _mm_set1_pd (DECAY_C2));
+    p = _mm_add_pd (_mm_mul_pd (p, f), _mm_set1_pd (DECAY_C1));
+    p = _mm_add_pd (_mm_mul_pd (p, f), _mm_set1_pd (1.0));
+    __m128i exponent = _mm_slli_epi64 (_mm_sub_epi64 (_mm_castpd_si128 (shifted), roundMagicI), 52);
+    _mm_storeu_pd (weights + i, _mm_castsi128_pd (_mm_add_epi64 (_mm_castpd_si128 (p), exponent)));
+  }
+#endif
+  for (; i < n; i++)
+  {
+    weights[i] = ScalarDecay (now - timestamps[i], rate);
+  }
+}
+
+//trustScore[ids[i]] += exp2(rate * (now - timestamps[i]))
+inline void
+ScatterAddDecay(const uint32_t *ids, const int64_t *timestamps, uint32_t n, int64_t now, double rate, std::vector<double> &trustScore)
+{
+  double weights[64];
+  for (uint32_t start = 0; start < n; start += 64)
+  {
+    uint32_t len = n - start < 64 ? n - start : 64;
+    DecayWeights (timestamps + start, len, now, rate, weights);
+    for (uint32_t i = 0; i < len; i++)
+    {
+      trustScore[ids[start + i]] += weights[i];
+    }
+  }
+}
+
+//the encounter list classes define
+
+/*
+* ScoreAccumulator keeps one running social-tie score per neighbor.
+* Since the score is a pure exponential decay, every encounter is folded into
+* its neighbor's score at insert time and the score is only rescaled to the
+* current time when it is read, so a query costs O(neighbors) instead of
+* O(all encounters since the start of the run).
+*/
+class ScoreAccumulator
+{
+public:
+  ScoreAccumulator();
+  ScoreAccumulator(int nodeSize, double factor, double lambda);
+  void AddEncounter(uint32_t id, Time timestamp);
+  void RemoveEncounter(uint32_t id, Time timestamp);
+  double GetScore(uint32_t id, Time curr_time);
+  void GetScores(Time curr_time, std::vector<double> &neighborScores);
+  void Reset(const std::vector<double> &trustScore, Time curr_time);
+  const std::vector<uint32_t>& GetNeighbors();
+  uint64_t GetNeighborChanges();
+private:
+  double Decay(int64_t from, int64_t to);
+  double factor;
+  double lambda;
+  double rate; //log2 of the decay per nanosecond
+  std::vector<double> score; //score of each node, valid at lastUpdate
+  std::vector<int64_t> lastUpdate; //in nanoseconds
+  std::vector<int64_t> stampBuffer; //scratch space for GetScores
+  std::vector<double> weightBuffer;
+  std::vector<uint32_t> encounterNum; //live encounters per node
+  std::vector<uint32_t> neighbors; //ids with a score, kept sorted
+  uint64_t neighborChanges; //nodes that joined or left neighbors so far
+};
+
+/*
+* EncounterList is a ring buffer of the hellos heard in the last validPeriod.
+* Node ids and timestamps (in nanoseconds) live in two separate arrays so a
+* scan over them stays in contiguous memory. Entries older than validPeriod
+* are evicted as new ones are appended, which bounds the memory of each node.
+*/
+class EncounterList : public Object
+{
+public:
+  EncounterList();
+  EncounterList(int nodeSize, double factor, double lambda, Time validPeriod);
+  void InsertItem(uint32_t id, Time timestamp);
+  void DeleteItem(Time end);
+  uint32_t GetSize();
+  uint64_t GetChurn(Time curr_time);
+  std::vector<uint32_t> calculateMaxScore(Time curr_time, double threshold, NeighborSet &neighbors);
+  void Save(SnapshotBuffer &buffer);
+  bool Load(SnapshotBuffer &buffer);
+  int nodeSize;
+  double factor;
+  double lambda;
+  Time validPeriod;
+  ScoreAccumulator scores;
+private:
+  void Grow();
+  void RebuildScores(Time curr_time);
+  std::vector<uint32_t> ids;
+  std::vector<int64_t> timestamps;
+  uint32_t head; //index of the oldest entry
+  uint32_t count;
+  uint32_t removedSinceRebuild;
+  std::vector<double> trustScore; //scratch space for RebuildScores
+  std::vector<double> neighborScores; //scratch space for calculateMaxScore
+}; // class define ends;
+
+// function define starts
+
+inline ScoreAccumulator::ScoreAccumulator()
+{
+}
+
+inline ScoreAccumulator::ScoreAccumulator(int nodeSize, double factor, double lambda)
+{
+  this -> factor = factor;
+  this -> lambda = lambda;
+  this -> rate = DecayRate(factor, lambda);
+  this -> score.resize(nodeSize, 0.0);
+  this -> lastUpdate.resize(nodeSize, 0);
+  this -> encounterNum.resize(nodeSize, 0);
+  this -> neighborChanges = 0;
+}
+
+inline double
+ScoreAccumulator::Decay(int64_t from, int64_t to)
+{
+  return ScalarDecay(to - from, rate);
+}
+
+inline void
+ScoreAccumulator::AddEncounter(uint32_t id, Time timestamp)
+{
+  if (encounterNum[id] == 0)
+  {
+    std::vector<uint32_t>::iterator pos = std::lower_bound(neighbors.begin(), neighbors.end(), id);
+    neighbors.insert(pos, id);
+    neighborChanges++;
+    score[id] = 0.0;
+  }
+  else
+  {
+    score[id] *= Decay(lastUpdate[id], timestamp.GetNanoSeconds());
+  }
+  encounterNum[id]++;
+  score[id] += 1.0;
+  lastUpdate[id] = timestamp.GetNanoSeconds();
+}
+
+inline void
+ScoreAccumulator::RemoveEncounter(uint32_t id, Time timestamp)
+{
+  if (encounterNum[id] == 0)
+    return;
+  encounterNum[id]--;
+  if (encounterNum[id] == 0)
+  {
+    //drop the node instead of subtracting, so no rounding residue is left behind
+    score[id] = 0.0;
+    std::vector<uint32_t>::iterator pos = std::lower_bound(neighbors.begin(), neighbors.end(), id);
+    neighbors.erase(pos);
+    neighborChanges++;
+    return;
+  }
+  //the removed encounter contributes its weight as of lastUpdate
+  score[id] -= Decay(timestamp.GetNanoSeconds(), lastUpdate[id]);
+  if (score[id] < 0.0)
+    score[id] = 0.0;
+}
+
+inline double
+ScoreAccumulator::GetScore(uint32_t id, Time curr_time)
+{
+  if (encounterNum[id] == 0)
+    return 0.0;
+  return score[id] * Decay(lastUpdate[id], curr_time.GetNanoSeconds());
+}
+
+//scores of all neighbors at curr_time, in the order of GetNeighbors
+inline void
+ScoreAccumulator::GetScores(Time curr_time, std::vector<double> &neighborScores)
+{
+  uint32_t n = neighbors.size();
+  neighborScores.resize(n);
+  if (n == 0)
+    return;
+  stampBuffer.resize(n);
+  weightBuffer.resize(n);
+  for (uint32_t i = 0; i < n; i++)
+  {
+    stampBuffer[i] = lastUpdate[neighbors[i]];
+  }
+  DecayWeights(&stampBuffer[0], n, curr_time.GetNanoSeconds(), rate, &weightBuffer[0]);
+  for (uint32_t i = 0; i < n; i++)
+  {
+    neighborScores[i] = score[neighbors[i]] * weightBuffer[i];
+  }
+}
+
+//replace the running scores with freshly summed ones, valid at curr_time
+inline void
+ScoreAccumulator::Reset(const std::vector<double> &trustScore, Time curr_time)
+{
+  for (uint32_t i = 0; i < neighbors.size(); i++)
+  {
+    score[neighbors[i]] = trustScore[neighbors[i]];
+    lastUpdate[neighbors[i]] = curr_time.GetNanoSeconds();
+  }
+}
+
+inline const std::vector<uint32_t>&
+ScoreAccumulator::GetNeighbors()
+{
+  return this -> neighbors;
+}
+
+inline uint64_t
+ScoreAccumulator::GetNeighborChanges()
+{
+  return this -> neighborChanges;
+}
+
+inline EncounterList::EncounterList()
+{
+}
+
+inline EncounterList::EncounterList(int nodeSize, double factor, double lambda, Time validPeriod) 
+  : scores(nodeSize, factor, lambda)
+{
+  this -> factor = factor;
+  this -> lambda = lambda;
+  this -> validPeriod = validPeriod;
+  this -> head = 0;
+  this -> count = 0;
+  this -> removedSinceRebuild = 0;
+  this -> trustScore.resize(nodeSize, 0.0);
+  this -> ids.resize(16);
+  this -> timestamps.resize(16);
+  //factor = 1 / 2.0;
+  //lambda = exp (-4);
+  //validPeriod = 20;
+}
+
+inline void
+EncounterList::Grow()
+{
+  uint32_t capacity = ids.size();
+  std::vector<uint32_t> newIds(capacity * 2);
+  std::vector<int64_t> newTimestamps(capacity * 2);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    newIds[i] = ids[(head + i) % capacity];
+    newTimestamps[i] = timestamps[(head + i) % capacity];
+  }
+  ids.swap(newIds);
+  timestamps.swap(newTimestamps);
+  head = 0;
+}
+
+inline void
+EncounterList::InsertItem(uint32_t id, Time timestamp)
+{
+  DeleteItem(timestamp - validPeriod);
+  if (count == ids.size())
+    Grow();
+  uint32_t tail = (head + count) % ids.size();
+  ids[tail] = id;
+  timestamps[tail] = timestamp.GetNanoSeconds();
+  count++;
+  scores.AddEncounter(id, timestamp);
+}
+
+//evict every encounter older than end
+inline void
+EncounterList::DeleteItem(Time end)
+{
+  int64_t endNs = end.GetNanoSeconds();
+  while (count > 0 && timestamps[head] < endNs)
+  {
+    scores.RemoveEncounter(ids[head], NanoSeconds(timestamps[head]));
+    head = (head + 1) % ids.size();
+    count--;
+    removedSinceRebuild++;
+  }
+  //every subtraction leaves a little rounding error in the running scores,
+  //so once as many entries were evicted as are left, sum them up again
+  if (count > 0 && removedSinceRebuild > count)
+    RebuildScores(NanoSeconds(timestamps[(head + count - 1) % ids.size()]));
+}
+
+//recompute every score from the live entries with the batch decay kernel
+inline void
+EncounterList::RebuildScores(Time curr_time)
+{
+  const std::vector<uint32_t> &metNodes = scores.GetNeighbors();
+  for (uint32_t i = 0; i < metNodes.size(); i++)
+  {
+    trustScore[metNodes[i]] = 0.0;
+  }
+  //the live entries are at most two contiguous runs of the ring
+  uint32_t capacity = ids.size();
+  uint32_t firstRun = head + count <= capacity ? count : capacity - head;
+  double rate = DecayRate(factor, lambda);
+  ScatterAddDecay(&ids[head], &timestamps[head], firstRun, curr_time.GetNanoSeconds(), rate, trustScore);
+  ScatterAddDecay(&ids[0], &timestamps[0], count - firstRun, curr_time.GetNanoSeconds(), rate, trustScore);
+  scores.Reset(trustScore, curr_time);
+  removedSinceRebuild = 0;
+}
+
+inline uint32_t
+EncounterList::GetSize()
+{
+  return this -> count;
+}
+
+//number of new or expired neighbors so far, with expiry brought up to curr_time
+inline uint64_t
+EncounterList::GetChurn(Time curr_time)
+{
+  DeleteItem(curr_time - validPeriod);
+  return scores.GetNeighborChanges();
+}
+
+//scores come from the running accumulator, so this only walks the nodes we have met
+inline std::vector<uint32_t> 
+EncounterList::calculateMaxScore(Time curr_time, double threshold, NeighborSet &neighbors) 
+{
+  DeleteItem(curr_time - validPeriod);
+  const std::vector<uint32_t> &metNodes = scores.GetNeighbors();
+  scores.GetScores(curr_time, neighborScores);
+
+  std::vector<uint32_t> bunch_of_nodeID;
+  neighbors.Clear();
+  for (int i = 0 ; i < (int) metNodes.size() ; i++) {
+    uint32_t id = metNodes[i];
+    if (neighborScores[i] > 0) 
+    {
+      neighbors.Insert(id);
+      if (neighborScores[i] > threshold) {
+        bunch_of_nodeID.push_back(id);
+      }
+    }
+  }
+  return bunch_of_nodeID;
+}
+
+//the live encounters, oldest first
+inline void
+EncounterList::Save(SnapshotBuffer &buffer)
+{
+  buffer.Put(count);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    buffer.Put(ids[(head + i) % ids.size()]);
+    buffer.Put(timestamps[(head + i) % ids.size()]);
+  }
+}
+
+//replace the encounters with saved ones; the scores are summed up again as they are inserted
+inline bool
+EncounterList::Load(SnapshotBuffer &buffer)
+{
+  uint32_t saved = 0;
+  if (!buffer.Get(saved))
+    return false;
+  this -> scores = ScoreAccumulator(trustScore.size(), factor, lambda);
+  this -> head = 0;
+  this -> count = 0;
+  this -> removedSinceRebuild = 0;
+  for (uint32_t i = 0; i < saved; i++)
+  {
+    uint32_t id = 0;
+    int64_t timestamp = 0;
+    buffer.Get(id);
+    if (!buffer.Get(timestamp) || id >= trustScore.size())
+      return false;
+    InsertItem(id, NanoSeconds(timestamp));
+  }
+  return true;
+}
+
+// encounter list function define ends
+
+/*
+* MatchTable holds the message and key halves a node is still waiting to
+* match, plus the keys it has already decoded. Only pending halves get an
+* entry, in a small open addressing hash table, and a pending half is dropped
+* by a timer wheel once it is older than the match window. A key leaves the
+* table once it is decoded and is kept as one bit in a bitset indexed by key.
+*/
+static const uint32_t MATCH_WHEEL_SLOTS = 64; //the wheel spans two match windows
+
+class MatchTable
+{
+public:
+  enum Half { MESSAGE = 1, KEY = 2 };
+  MatchTable();
+  MatchTable(Time window);
+  bool Match(uint32_t key, Half half, Time now);
+  bool IsDecoded(uint32_t key);
+  uint32_t GetSize();
+  void Save(SnapshotBuffer &buffer);
+  bool Load(SnapshotBuffer &buffer, Time now);
+private:
+  enum State { EMPTY = 0, USED = 1, DELETED = 2 };
+  enum Flag { HAS_MESSAGE = 1, HAS_KEY = 2, DECODED = 4 }; //DECODED only appears in snapshots
+  struct Entry
+  {
+    uint32_t key;
+    uint8_t state;
+    uint8_t flags;
+    int64_t halfTime[2]; //arrival of the message and of the key, in nanoseconds
+  };
+  Entry* Find(uint32_t key);
+  Entry* Insert(uint32_t key);
+  void Erase(Entry *entry);
+  void Rehash(uint32_t capacity);
+  void Schedule(uint32_t key, int64_t expiry);
+  void Advance(int64_t now);
+  int64_t window;
+  int64_t slotWidth;
+  std::vector<Entry> entries;
+  uint32_t used; //entries in state USED
+  uint32_t deleted;
+  std::vector<bool> decoded; //indexed by key
+  uint32_t decodedCount;
+  std::vector<std::vector<uint32_t> > wheel; //keys to check for expiry, per tick
+  int64_t lastTick;
+};
+
+inline MatchTable::MatchTable()
+{
+}
+
+inline MatchTable::MatchTable(Time window)
+{
+  this -> window = window.GetNanoSeconds();
+  this -> slotWidth = this -> window / (MATCH_WHEEL_SLOTS / 2) + 1;
+  this -> used = 0;
+  this -> deleted = 0;
+  this -> decodedCount = 0;
+  this -> lastTick = 0;
+  this -> wheel.resize(MATCH_WHEEL_SLOTS);
+  Rehash(16);
+}
+
+static inline uint32_t
+HashKey(uint32_t key)
+{
+  return key * 2654435761u;
+}
+
+inline MatchTable::Entry*
+MatchTable::Find(uint32_t key)
+{
+  uint32_t mask = entries.size() - 1;
+  for (uint32_t i = HashKey(key) & mask; ; i = (i + 1) & mask)
+  {
+    Entry &entry = entries[i];
+    if (entry.state == EMPTY)
+      return NULL;
+    if (entry.state == USED && entry.key == key)
+      return &entry;
+  }
+}
+
+inline MatchTable::Entry*
+MatchTable::Insert(uint32_t key)
+{
+  //keep at least a quarter of the slots empty so probing stays short
+  if ((used + deleted + 1) * 4 > entries.size() * 3)
+    Rehash(used * 2 >= entries.size() / 2 ? entries.size() * 2 : entries.size());
+  uint32_t mask = entries.size() - 1;
+  uint32_t i = HashKey(key) & mask;
+  while (entries[i].state == USED)
+  {
+    i = (i + 1) & mask;
+  }
+  if (entries[i].state == DELETED)
+    deleted--;
+  used++;
+  Entry &entry = entries[i];
+  entry.key = key;
+  entry.state = USED;
+  entry.flags = 0;
+  entry.halfTime[0] = 0;
+  entry.halfTime[1] = 0;
+  return &entry;
+}
+
+inline void
+MatchTable::Erase(Entry *entry)
+{
+  entry -> state = DELETED;
+  used--;
+  deleted++;
+}
+
+inline void
+MatchTable::Rehash(uint32_t capacity)
+{
+  std::vector<Entry> old;
+  old.swap(entries);
+  Entry empty;
+  empty.state = EMPTY;
+  entries.resize(capacity, empty);
+  used = 0;
+  deleted = 0;
+  for (uint32_t i = 0; i < old.size(); i++)
+  {
+    if (old[i].state == USED)
+      *Insert(old[i].key) = old[i];
+  }
+}
+
+inline void
+MatchTable::Schedule(uint32_t key, int64_t expiry)
+{
+  //the first tick that starts after expiry
+  int64_t tick = expiry / slotWidth + 1;
+  wheel[tick % MATCH_WHEEL_SLOTS].push_back(key);
+}
+
+//drop every pending half that fell out of the match window by now
+inline void
+MatchTable::Advance(int64_t now)
+{
+  int64_t nowTick = now / slotWidth;
+  int64_t firstTick = lastTick + 1;
+  if (nowTick - firstTick >= (int64_t) MATCH_WHEEL_SLOTS)
+    firstTick = nowTick - MATCH_WHEEL_SLOTS + 1;
+  for (int64_t tick = firstTick; tick <= nowTick; tick++)
+  {
+    std::vector<uint32_t> &slot = wheel[tick % MATCH_WHEEL_SLOTS];
+    std::vector<uint32_t> due;
+    due.swap(slot);
+    for (uint32_t i = 0; i < due.size(); i++)
+    {
+      Entry *entry = Find(due[i]);
+      if (entry == NULL)
+        continue;
+      for (int half = 0; half < 2; half++)
+      {
+        if ((entry -> flags & (1 << half)) && entry -> halfTime[half] + window < now)
+          entry -> flags &= ~(1 << half);
+      }
+      if (entry -> flags == 0)
+        Erase(entry);
+      else
+        Schedule(entry -> key, std::max(entry -> halfTime[0], entry -> halfTime[1]) + window);
+    }
+  }
+  if (nowTick > lastTick)
+    lastTick = nowTick;
+}
+
+//store one half of key; returns true if it completes a match within the window
+inline bool
+MatchTable::Match(uint32_t key, Half half, Time now)
+{
+  int64_t t = now.GetNanoSeconds();
+  Advance(t);
+  if (IsDecoded(key))
+    return false;
+  Entry *entry = Find(key);
+  if (entry == NULL)
+    entry = Insert(key);
+  int own = half == MESSAGE ? 0 : 1;
+  int other = 1 - own;
+  if ((entry -> flags & (1 << other)) && t - entry -> halfTime[other] <= window)
+  {
+    Erase(entry);
+    if (key >= decoded.size())
+      decoded.resize(std::max((size_t) key + 1, decoded.size() * 2), false);
+    decoded[key] = true;
+    decodedCount++;
+    return true;
+  }
+  entry -> flags |= 1 << own;
+  entry -> halfTime[own] = t;
+  Schedule(key, t + window);
+  return false;
+}
+
+inline bool
+MatchTable::IsDecoded(uint32_t key)
+{
+  return key < decoded.size() && decoded[key];
+}
+
+inline uint32_t
+MatchTable::GetSize()
+{
+  return this -> used;
+}
+
+//the decoded keys and pending halves; the expiry wheel is rebuilt from them on load
+inline void
+MatchTable::Save(SnapshotBuffer &buffer)
+{
+  uint32_t saved = used + decodedCount;
+  buffer.Put(saved);
+  for (uint32_t key = 0; key < decoded.size(); key++)
+  {
+    if (!decoded[key])
+      continue;
+    uint8_t flags = DECODED;
+    int64_t halfTime = 0;
+    buffer.Put(key);
+    buffer.Put(flags);
+    buffer.Put(halfTime);
+    buffer.Put(halfTime);
+  }
+  for (uint32_t i = 0; i < entries.size(); i++)
+  {
+    if (entries[i].state != USED)
+      continue;
+    buffer.Put(entries[i].key);
+    buffer.Put(entries[i].flags);
+    buffer.Put(entries[i].halfTime[0]);
+    buffer.Put(entries[i].halfTime[1]);
+  }
+}
+
+inline bool
+MatchTable::Load(SnapshotBuffer &buffer, Time now)
+{
+  uint32_t saved = 0;
+  if (!buffer.Get(saved))
+    return false;
+  entries.clear();
+  Rehash(16);
+  decoded.clear();
+  decodedCount = 0;
+  for (uint32_t i = 0; i < wheel.size(); i++)
+    wheel[i].clear();
+  this -> lastTick = now.GetNanoSeconds() / slotWidth;
+  for (uint32_t i = 0; i < saved; i++)
+  {
+    uint32_t key = 0;
+    uint8_t flags = 0;
+    int64_t halfTime[2] = { 0, 0 };
+    buffer.Get(key);
+    buffer.Get(flags);
+    buffer.Get(halfTime[0]);
+    if (!buffer.Get(halfTime[1]))
+      return false;
+    if (flags & DECODED)
+    {
+      if (key >= decoded.size())
+        decoded.resize((size_t) key + 1, false);
+      if (!decoded[key])
+        decodedCount++;
+      decoded[key] = true;
+      continue;
+    }
+    Entry *entry = Insert(key);
+    entry -> flags = flags;
+    entry -> halfTime[0] = halfTime[0];
+    entry -> halfTime[1] = halfTime[1];
+    Schedule(key, std::max(halfTime[0], halfTime[1]) + window);
+  }
+  return true;
+}
+
+
+/*
+* SeenCache remembers the packets a node has already acted on, keyed by packet
+* type, key number and hop target. It is a fixed array of slots indexed by a
+* hash of that triple, so it never grows; a colliding packet simply takes the
+* slot over. An entry only counts as seen for the duplicate window.
+*/
+static const uint32_t SEEN_CACHE_SLOTS = 256;
+
+class SeenCache
+{
+public:
+  SeenCache();
+  SeenCache(Time window);
+  bool CheckAndInsert(uint8_t packetType, uint32_t key, uint32_t target, Time now);
+private:
+  struct Slot
+  {
+    uint32_t key;
+    uint32_t target;
+    uint8_t packetType;
+    bool valid;
+    int64_t time; //last time the packet was seen, in nanoseconds
+  };
+  int64_t window;
+  std::vector<Slot> slots;
+};
+
+inline SeenCache::SeenCache()
+{
+}
+
+inline SeenCache::SeenCache(Time window)
+{
+  this -> window = window.GetNanoSeconds();
+  Slot empty;
+  empty.key = 0;
+  empty.target = 0;
+  empty.packetType = 0;
+  empty.valid = false;
+  empty.time = 0;
+  this -> slots.resize(SEEN_CACHE_SLOTS, empty);
+}
+
+//returns true if the packet was already seen within the window, and records it either way
+inline bool
+SeenCache::CheckAndInsert(uint8_t packetType, uint32_t key, uint32_t target, Time now)
+{
+  uint64_t hash = ((((uint64_t) packetType << 32) ^ target) * 0x9E3779B97F4A7C15ULL) ^ key;
+  Slot &slot = slots[(uint32_t) ((hash * 0x9E3779B97F4A7C15ULL) >> 56) % SEEN_CACHE_SLOTS];
+  int64_t t = now.GetNanoSeconds();
+  bool seen = slot.valid && slot.packetType == packetType && slot.target == target &&
+              slot.key == key && t - slot.time <= window;
+  slot.packetType = packetType;
+  slot.target = target;
+  slot.key = key;
+  slot.time = t;
+  slot.valid = true;
+  return seen;
+}
+
+} //namespace ns3
+
+#endif /*SOCIALTIE_H*/
@@ -0,0 +1,150 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+
+//
+// Checks the batch decay kernel of SocialTie.h against the pow() it replaced:
+// every weight DecayWeights and ScalarDecay produce must be within 3e-10 of
+// pow(factor, lambda * dt), relative. The vector path is picked at compile
+// time, so the test is built once per instruction set:
+//
+// ./waf --run decay-accuracy-test                     (SSE2, the x86-64 default)
+// CXXFLAGS="-mavx2" ./waf --run decay-accuracy-test   (AVX2)
+//
+// The scalar path is ScalarDecay, which is checked directly on every build,
+// as well as through the tail DecayWeights leaves after the last full vector.
+// The program prints the worst error per path and exits non-zero on failure.
+//
+
+#include "SocialTie.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+using namespace ns3;
+
+static const double DECAY_MAX_ERROR = 3e-10; //the bound documented in SocialTie.h
+static const int64_t NS_PER_SECOND = 1000000000LL;
+
+static int failures = 0;
+
+static double
+RelativeError(double value, double reference)
+{
+  return fabs(value - reference) / reference;
+}
+
+static void
+Check(const char *what, double worst)
+{
+  printf("%-36s worst relative error %.3g\n", what, worst);
+  if (!(worst <= DECAY_MAX_ERROR))
+  {
+    printf("FAIL: %s is above %.3g\n", what, DECAY_MAX_ERROR);
+    failures++;
+  }
+}
+
+//dt in nanoseconds spread over [0, maxSeconds], with odd offsets so f covers its range
+static std::vector<int64_t>
+Intervals(uint32_t n, double maxSeconds)
+{
+  std::vector<int64_t> dts(n);
+  for (uint32_t i = 0; i < n; i++)
+  {
+    double u = (double) rand() / RAND_MAX;
+    dts[i] = (int64_t) (u * maxSeconds * NS_PER_SECOND) + (rand() % 1000);
+  }
+  return dts;
+}
+
+//DecayWeights over a batch of length n, compared against pow
+static double
+BatchError(const std::vector<int64_t> &dts, uint32_t n, double factor, double lambda)
+{
+  int64_t now = 100000LL * NS_PER_SECOND;
+  std::vector<int64_t> timestamps(n);
+  std::vector<double> weights(n);
+  for (uint32_t i = 0; i < n; i++)
+    timestamps[i] = now - dts[i];
+  DecayWeights(&timestamps[0], n, now, DecayRate(factor, lambda), &weights[0]);
+  double worst = 0;
+  for (uint32_t i = 0; i < n; i++)
+  {
+    double reference = pow(factor, lambda * ((double) dts[i] / NS_PER_SECOND));
+    worst = std::max(worst, RelativeError(weights[i], reference));
+  }
+  return worst;
+}
+
+int
+main (int argc, char *argv[])
+{
+#if defined(__AVX2__)
+  const char *vectorPath = "DecayWeights AVX2";
+#elif defined(__SSE2__)
+  const char *vectorPath = "DecayWeights SSE2";
+#else
+  const char *vectorPath = "DecayWeights scalar";
+#endif
+  srand(218);
+  //the factor and lambda simple-adhoc.cc runs with, and a few faster decays
+  const double factors[] = { 0.5, 0.5, 0.9, 0.1 };
+  const double lambdas[] = { exp(-4), 0.1, 1.0, 2.0 };
+  const uint32_t sets = sizeof(factors) / sizeof(factors[0]);
+
+  double worstScalar = 0;
+  double worstVector = 0;
+  double worstTail = 0;
+  for (uint32_t s = 0; s < sets; s++)
+  {
+    double factor = factors[s];
+    double lambda = lambdas[s];
+    //keep pow well above the clamp so it is the reference, not the clamp
+    double maxSeconds = 500.0 / (lambda * -log(factor) / log(2.0));
+    if (maxSeconds > 1e6)
+      maxSeconds = 1e6;
+    std::vector<int64_t> dts = Intervals(100000, maxSeconds);
+    dts[0] = 0;
+    dts[1] = 1;
+
+    double rate = DecayRate(factor, lambda);
+    for (uint32_t i = 0; i < dts.size(); i++)
+    {
+      double reference = pow(factor, lambda * ((double) dts[i] / NS_PER_SECOND));
+      worstScalar = std::max(worstScalar, RelativeError(ScalarDecay(dts[i], rate), reference));
+    }
+    worstVector = std::max(worstVector, BatchError(dts, dts.size(), factor, lambda));
+    //every length up to two AVX2 vectors leaves a different partial tail
+    for (uint32_t n = 1; n <= 9; n++)
+      worstTail = std::max(worstTail, BatchError(dts, n, factor, lambda));
+  }
+  Check("ScalarDecay", worstScalar);
+  Check(vectorPath, worstVector);
+  Check("DecayWeights partial tail", worstTail);
+
+  //past DECAY_MIN_EXPONENT the weight is clamped to 2^DECAY_MIN_EXPONENT
+  double floorWeight = pow(2.0, DECAY_MIN_EXPONENT);
+  double rate = DecayRate(0.5, 1.0);
+  int64_t now = 100000LL * NS_PER_SECOND;
+  int64_t timestamps[7];
+  double weights[7];
+  for (uint32_t i = 0; i < 7; i++)
+    timestamps[i] = now - (int64_t) (1000 + 1000 * i) * NS_PER_SECOND;
+  DecayWeights(timestamps, 7, now, rate, weights);
+  double worstClamp = RelativeError(ScalarDecay(50000LL * NS_PER_SECOND, rate), floorWeight);
+  for (uint32_t i = 0; i < 7; i++)
+    worstClamp = std::max(worstClamp, RelativeError(weights[i], floorWeight));
+  Check("DECAY_MIN_EXPONENT clamp", worstClamp);
+  //right at the clamp the polynomial and the clamp must agree
+  int64_t edge = (int64_t) (DECAY_MIN_EXPONENT / rate);
+  Check("DECAY_MIN_EXPONENT edge", RelativeError(ScalarDecay(edge, rate), pow(0.5, (double) edge / NS_PER_SECOND)));
+
+  if (failures != 0)
+  {
+    printf("%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("all decay checks passed\n");
+  return 0;
+}
@@ -72,209 +72,258 @@
 #include <string>
 #include <map>
 #include <list>
+#include <sstream>
 #include <math.h>
+#include <algorithm>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include "SocialTie.h"
+#include "MobilityTrace.h"
+#include "Instrumentation.h"
+#include "Metrics.h"
 
 using namespace ns3;
 
-int nodesize_global = 50;
-double anonymityTotal = 0;
-double threshold_global = 1.0;
-double maliRatio = 0.5;
-int messageCount = 99;
-std::vector<bool> maliciousVector(nodesize_global, false);
-int rawTotalSent = 0;
-int gTotalSent = 0; //global send q
-std::vector<int> gTotalDecode; //unique messages decoded
-std::vector<int> m_decodeQ; //malicious decode q
-std::vector<int> g_decodeQ; //good decode q
-std::vector<uint64_t> messageSendTime(messageCount, Seconds(0.0).GetMilliSeconds());
-std::vector<uint64_t> messageReceivedTime(messageCount, 0);
-NodeContainer c;
-
-//
-struct ListNode {
-  int val;
-  ListNode *next;
-  ListNode(int x) : val(x), next(NULL) {}
-};
-
-/*mj;
-class LinkedList : public Object
-{
-public:
-  LinkedList();
-  LinkedList(int n);
-  void addNode(struct Node *head, int n);
-}
+/*
+* SimulationContext holds everything that belongs to one run: the parameters
+* it is started with and the results it collects. Every MyReceiver keeps a
+* pointer to the context of its run, so two runs never share state and a
+* worker process only has to fill in its own context before it starts.
 */
-
-
-//the encounter list classes define
-class EncounterTuple : public Object
-{
-public:
-  EncounterTuple();
-  EncounterTuple(uint32_t id, Time time);
-  uint32_t node_id;
-  Time timestamp;
-  Time GetTime();
-  uint32_t GetID();
-};
-
-class EncounterListItem : public Object
-{
-public:
-  EncounterListItem(EncounterTuple *tuple);
-
-  EncounterTuple curr_data;
-  EncounterListItem* prev;
-  EncounterListItem* next;
-};
-
-class EncounterList : public Object
+class SimulationContext
 {
 public:
-  EncounterList();
-  EncounterList(int nodeSize, double factor, double lambda, Time validPeriod);
-  void InsertItem(EncounterListItem *current);
-  void DeleteItem(Time end);
-  void Next();
-  std::vector<uint32_t> calculateMaxScore(int nodeSize, Time curr_time, double threshold, uint16_t &neighborNum, ListNode *neighbors);
+  SimulationContext();
+  void InitMalicious();
+  bool Set(const std::string &name, const std::string &value);
+  static bool IsChannel(const std::string &channel);
+  static std::string CsvHeader();
+  std::string CsvRow(uint32_t point);
+
+  //parameters, set from the command line or by the parallel driver
   int nodeSize;
-  double factor;
-  double lambda;
-  Time validPeriod;
-  EncounterListItem* head;
-  EncounterListItem* tail;
-}; // class define ends;
-
-// function define starts
- 
-EncounterTuple::EncounterTuple()
-{
-}
-
-EncounterTuple::EncounterTuple(uint32_t id, Time time)
-{
-  node_id = id;
-  timestamp = time;
-}
-
-Time
-EncounterTuple::GetTime(){
-  return this -> timestamp;
-}
+  int nodeSparseness;
+  int nodeTravel;
+  int nodeSpeed;
+  int movingDelay;
+  int sourceNode;
+  double threshold;
+  double maliRatio;
+  double validPeriod; //seconds an encounter counts towards the score
+  uint64_t matchWindow; //milliseconds a message and its key can be apart
+  uint64_t dupWindow; //milliseconds a forwarded packet is not forwarded again
+  std::string encounters; //"packet" for hello beacons, "analytic" to take encounters from the node positions
+  bool adaptiveBeacon; //tune each hello interval to the encounter churn
+  double beaconMin; //seconds, shortest adaptive hello interval
+  double beaconMax; //seconds, longest adaptive hello interval
+  uint32_t beaconJitter; //milliseconds
+  uint32_t beaconBudget;
+  double simulationTime; //seconds
+  bool animation; //write simple-adhoc.xml for NetAnim
+  std::string readMobility; //waypoint trace to replay instead of the random walk
+  std::string writeMobility; //waypoint trace to record the run's mobility to
+  std::string saveSnapshot; //file to save the social tie state of every node to at snapshotTime
+  std::string loadSnapshot; //file to start the social tie state of every node from
+  double snapshotTime; //seconds, when saveSnapshot is taken
+  std::string instrumentation; //JSON file for the counters of a build with SOCIAL_TIE_INSTRUMENT
+  std::string metricsFile; //JSON or CSV file the MetricsCollector writes at the end of the run
+  double metricsStep; //seconds between the points of the delivery ratio over time
+  std::string channel; //"wifi" for the 802.11b stack, "grid" or "disc" for GridRangeChannel under SimpleNetDevices, no MAC or PHY
+  double linkLatency; //milliseconds, disc channel only
+  std::string linkRate; //disc channel only
+  double linkLoss; //probability a frame is lost, disc channel only
+  uint64_t rngRun; //ns-3 run number, 0 keeps the one given by --RngRun
+
+  //results of the run
+  std::vector<bool> maliciousVector; //sized by InitMalicious once nodeSize is known
+  double anonymityTotal;
+  int rawTotalSent;
+  int gTotalSent;
+  DecodeAccounting decodes; //unique messages decoded, split by malicious and good nodes
+  MetricsCollector metrics; //message latencies, forwards per node and delivery over time
+  NodeContainer nodes;
+
+  //summary of the run, filled in by RunSimulation
+  double avgDelay; //milliseconds
+  double p50Delay; //milliseconds, from the latency histogram
+  double p99Delay;
+  double maxDelay;
+  double anonymity;
+  uint64_t beaconsSent;
+};
 
-uint32_t
-EncounterTuple::GetID()
+SimulationContext::SimulationContext()
 {
-  return this -> node_id;
+  this -> nodeSize = 50;
+  this -> nodeSparseness = 30;
+  this -> nodeTravel = 300;
+  this -> nodeSpeed = 100;
+  this -> movingDelay = 3;
+  this -> sourceNode = 2;
+  this -> threshold = 1.0;
+  this -> maliRatio = 0.5;
+  this -> validPeriod = 20.0;
+  this -> matchWindow = 1500;
+  this -> dupWindow = 1000;
+  this -> encounters = "packet";
+  this -> adaptiveBeacon = false;
+  this -> beaconMin = 0.25;
+  this -> beaconMax = 5.0;
+  this -> beaconJitter = 10;
+  this -> beaconBudget = 0;
+  this -> simulationTime = 55.0;
+  this -> animation = true;
+  this -> snapshotTime = 0.321;
+  this -> instrumentation = "instrumentation.json";
+  this -> metricsFile = "metrics.json";
+  this -> metricsStep = 1.0;
+  this -> channel = "wifi";
+  this -> linkLatency = 1.0;
+  this -> linkRate = "1Mbps";
+  this -> linkLoss = 0;
+  this -> rngRun = 0;
+  this -> anonymityTotal = 0;
+  this -> rawTotalSent = 0;
+  this -> gTotalSent = 0;
+  this -> avgDelay = 0;
+  this -> p50Delay = 0;
+  this -> p99Delay = 0;
+  this -> maxDelay = 0;
+  this -> anonymity = 0;
+  this -> beaconsSent = 0;
 }
 
-EncounterListItem::EncounterListItem(EncounterTuple *tuple)
-{
-  curr_data.node_id = tuple -> node_id;
-  curr_data.timestamp = tuple -> timestamp;
-  prev = NULL;
-  next = NULL;
-}
+//random streams with fixed numbers, so two runs differ only by their RngRun
+static const int64_t MALICIOUS_STREAM = 0;
+static const int64_t MOBILITY_STREAM = 1; //one or more per node from here on
+static const int64_t LOSS_STREAM = 1000000; //one per node from here on, clear of the mobility streams
+static const int64_t POSITION_STREAM = 2000000; //two for the start positions of a random walk, clear of the loss streams
+static const int64_t BEACON_STREAM = 2000002; //first hello slot of every node
+static const int64_t WIFI_STREAM = 2000003; //the 802.11b PHYs and MACs, several per node from here on
 
-EncounterList::EncounterList()
+//pick maliRatio * nodeSize distinct malicious nodes
+void
+SimulationContext::InitMalicious()
 {
+  this -> maliciousVector.assign(nodeSize, false);
+  Ptr<UniformRandomVariable> pick = CreateObject<UniformRandomVariable> ();
+  pick -> SetStream(MALICIOUS_STREAM);
+  int maliNumber = maliRatio * nodeSize;
+  int maliCount = 0;
+  while (maliCount < maliNumber) {
+    int randIdx = pick -> GetInteger(0, nodeSize - 1);
+    if (maliciousVector[randIdx] == false) {
+      maliciousVector[randIdx] = true;
+      maliCount++;
+    }
+  }
 }
 
-EncounterList::EncounterList(int nodeSize, double factor, double lambda, Time validPeriod) 
+//the link layers Build knows
+bool
+SimulationContext::IsChannel(const std::string &channel)
 {
-  this -> head = NULL;
-  this -> tail = NULL;
-  this -> factor = factor;
-  this -> lambda = lambda;
-  this -> validPeriod = validPeriod;
-  //factor = 1 / 2.0;
-  //lambda = exp (-4);
-  //validPeriod = 20;
+  return channel == "wifi" || channel == "grid" || channel == "disc";
 }
 
-void
-EncounterList::InsertItem(EncounterListItem *current)
+//set a parameter by its command line name, used by the sweep specs; false for an unknown name or channel
+bool
+SimulationContext::Set(const std::string &name, const std::string &value)
 {
-  if (head == NULL && tail == NULL) {
-    head = current;
-    tail = current;
-    return ;
-  }
-  current -> prev = tail;
-  tail -> next = current;
-  tail = current;
+  const char *v = value.c_str();
+  if (name == "nodeSize") nodeSize = atoi(v);
+  else if (name == "nodeSparseness") nodeSparseness = atoi(v);
+  else if (name == "nodeTravel") nodeTravel = atoi(v);
+  else if (name == "nodeSpeed") nodeSpeed = atoi(v);
+  else if (name == "delay") movingDelay = atoi(v);
+  else if (name == "sourceNode") sourceNode = atoi(v);
+  else if (name == "threshold") threshold = atof(v);
+  else if (name == "maliRatio") maliRatio = atof(v);
+  else if (name == "validPeriod") validPeriod = atof(v);
+  else if (name == "matchWindow") matchWindow = strtoull(v, NULL, 10);
+  else if (name == "dupWindow") dupWindow = strtoull(v, NULL, 10);
+  else if (name == "encounters") encounters = value;
+  else if (name == "adaptiveBeacon") adaptiveBeacon = value == "1" || value == "true";
+  else if (name == "beaconMin") beaconMin = atof(v);
+  else if (name == "beaconMax") beaconMax = atof(v);
+  else if (name == "beaconJitter") beaconJitter = atoi(v);
+  else if (name == "beaconBudget") beaconBudget = atoi(v);
+  else if (name == "simulationTime") simulationTime = atof(v);
+  else if (name == "channel" && IsChannel(value)) channel = value;
+  else if (name == "readMobility") readMobility = value;
+  else if (name == "loadSnapshot") loadSnapshot = value;
+  else if (name == "linkLatency") linkLatency = atof(v);
+  else if (name == "linkRate") linkRate = value;
+  else if (name == "linkLoss") linkLoss = atof(v);
+  else return false;
+  return true;
 }
 
-void
-EncounterList::DeleteItem(Time end)
+std::string
+SimulationContext::CsvHeader()
 {
-  Time tx = head -> curr_data.GetTime();
-  while (tx < end && head != NULL)
-  {
-    head = head -> next;
-    if (head == NULL)
-    {
-      tail = NULL;
-      return;
-    }
-    head -> prev = NULL;
-    tx = head -> curr_data.GetTime();
-  }
+  return "point,rngRun,channel,linkLatency,linkRate,linkLoss,nodeSize,nodeSparseness,nodeTravel,nodeSpeed,delay,sourceNode,threshold,maliRatio,validPeriod,"
+         "matchWindow,dupWindow,encounters,adaptiveBeacon,beaconMin,beaconMax,beaconJitter,beaconBudget,simulationTime,readMobility,loadSnapshot,sent,decoded,decodedByNodeType,decodedMalicious,deliveryRatio,avgDelayMs,p50DelayMs,p99DelayMs,maxDelayMs,anonymity,beaconsSent";
 }
 
-
-std::vector<uint32_t> 
-EncounterList::calculateMaxScore(int nodeSize, Time curr_time, double threshold, uint16_t &neighborNum, ListNode* neighbors) 
+//one results line per run, the columns follow CsvHeader
+std::string
+SimulationContext::CsvRow(uint32_t point)
 {
-  std::vector<double> trustScore(nodeSize, 0.0);
-  EncounterListItem *p = this -> head;
-  while (p != NULL)
-  {
-    EncounterTuple curr_tuple = p -> curr_data; 
-    trustScore[curr_tuple.GetID()] += pow (factor, lambda * (curr_time.GetSeconds() - curr_tuple.timestamp.GetSeconds()));
-    p = p -> next;
-    //NS_LOG_UNCOND (curr_tuple.GetID());
-    //NS_LOG_UNCOND (trustScore[curr_tuple.GetID()]);
-  }
-
-  std::vector<uint32_t> bunch_of_nodeID;
-  neighborNum = 0;
-  ListNode *node = neighbors;
-  for (int i = 0 ; i < nodeSize ; i++) {
-    if (trustScore[i] > 0) 
-    {
-      neighborNum++;
-      node -> next = new ListNode(i);
-      node = node -> next;
-      if (trustScore[i] > threshold) {
-        bunch_of_nodeID.push_back((uint32_t) i);
-      }
-    }
-  }
-  node -> next = NULL;
-  return bunch_of_nodeID;
+  std::ostringstream row;
+  double deliveryRatio = gTotalSent > 0 ? decodes.GetTotalCount() / (double) gTotalSent : 0;
+  row << point << ',' << rngRun << ',' << channel << ',' << linkLatency << ',' << linkRate << ',' << linkLoss << ',' << nodeSize << ',' << nodeSparseness << ',' << nodeTravel << ','
+      << nodeSpeed << ',' << movingDelay << ',' << sourceNode << ',' << threshold << ',' << maliRatio << ',' << validPeriod << ','
+      << matchWindow << ',' << dupWindow << ',' << encounters << ',' << adaptiveBeacon << ',' << beaconMin << ',' << beaconMax << ','
+      << beaconJitter << ',' << beaconBudget << ',' << simulationTime << ',' << readMobility << ',' << loadSnapshot << ','
+      << gTotalSent << ',' << decodes.GetTotalCount() << ',' << decodes.GetMaliciousCount() + decodes.GetGoodCount() << ','
+      << decodes.GetMaliciousCount() << ',' << deliveryRatio << ',' << avgDelay << ','
+      << p50Delay << ',' << p99Delay << ',' << maxDelay << ',' << anonymity << ','
+      << beaconsSent;
+  return row.str();
 }
 
-// encounter list function define ends
-
 /**********
 *
-* MyHeader is a generic header that is 2 bytes. 
-* This is to accomodate packets with varying headers for anonymity.
+* ProtocolHeader is the one header of every packet in the protocol.
+* It starts with a version/type byte and a flags byte. Then come the node id
+* as a varint (the sender for hello messages, the receiver otherwise, left
+* out when the packet is for any node or has a recipient list) and, for
+* messages and keys, the
+* key number as a varint. The optional score and recipient list follow when
+* their flag is set. The recipient list lets one broadcast address every
+* next hop of a forwarding decision; it is a varint count followed by varint
+* deltas of the sorted ids.
 *
 **********/
-class MyHeader : public Header 
+class ProtocolHeader : public Header 
 {
 public:
-
-  MyHeader ();
-  virtual ~MyHeader ();
-
-  void SetData (uint16_t data);
-  uint16_t GetData (void) const;
+  enum PacketType { HELLO = 0, MESSAGE = 1, KEY = 2 };
+  static const uint8_t VERSION = 1;
+  static const uint32_t ANY_NODE = 0xffffffff;
+
+  ProtocolHeader ();
+  virtual ~ProtocolHeader ();
+
+  bool IsSupported (void) const;
+  void SetType (uint8_t type);
+  uint8_t GetType (void) const;
+  void SetNodeId (uint32_t id);
+  uint32_t GetNodeId (void) const;
+  bool IsForAnyNode (void) const;
+  void SetKeyNum (uint32_t keyNum);
+  uint32_t GetKeyNum (void) const;
+  bool HasScore (void) const;
+  double GetScore (void) const;
+  void SetRecipients (const std::vector<uint32_t> &recipients);
+  bool HasRecipients (void) const;
+  bool IsRecipient (uint32_t id) const;
 
   static TypeId GetTypeId (void);
   virtual TypeId GetInstanceTypeId (void) const;
@@ -283,62 +332,275 @@ public:
   virtual uint32_t Deserialize (Buffer::Iterator start);
   virtual uint32_t GetSerializedSize (void) const;
 private:
-  uint16_t m_data;
+  enum Flag { FOR_ANY_NODE = 1, HAS_SCORE = 2, HAS_RECIPIENTS = 4 };
+  bool HasNodeId (void) const;
+  static uint32_t VarintSize (uint32_t value);
+  static void WriteVarint (Buffer::Iterator &i, uint32_t value);
+  static uint32_t ReadVarint (Buffer::Iterator &i);
+  uint8_t m_version;
+  uint8_t m_type;
+  uint8_t m_flags;
+  uint32_t m_nodeId;
+  uint32_t m_keyNum;
+  float m_score;
+  std::vector<uint32_t> m_recipients; //sorted
 };
 
-MyHeader::MyHeader ()
+const uint8_t ProtocolHeader::VERSION;
+const uint32_t ProtocolHeader::ANY_NODE;
+
+ProtocolHeader::ProtocolHeader ()
+  : m_version (VERSION),
+    m_type (HELLO),
+    m_flags (0),
+    m_nodeId (0),
+    m_keyNum (0),
+    m_score (0)
 {
-  // default constructor
 }
-MyHeader::~MyHeader ()
+ProtocolHeader::~ProtocolHeader ()
 {}
 
 TypeId 
-MyHeader::GetTypeId (void)
+ProtocolHeader::GetTypeId (void)
 {
-  static TypeId tid = TypeId ("ns3::MyHeader")
+  static TypeId tid = TypeId ("ns3::ProtocolHeader")
     .SetParent<Header> ()
     ;
   return tid;
 }
 TypeId 
-MyHeader::GetInstanceTypeId (void) const
+ProtocolHeader::GetInstanceTypeId (void) const
 {
   return GetTypeId ();
 }
 
 void 
-MyHeader::Print (std::ostream &os) const
+ProtocolHeader::Print (std::ostream &os) const
+{
+  os << "version=" << (uint32_t) m_version << " type=" << (uint32_t) m_type;
+  if (IsForAnyNode ())
+    os << " node=any";
+  else if (HasNodeId ())
+    os << " node=" << m_nodeId;
+  if (m_type != HELLO)
+    os << " key=" << m_keyNum;
+  if (HasScore ())
+    os << " score=" << m_score;
+  if (HasRecipients ())
+    {
+      os << " recipients=";
+      for (uint32_t i = 0; i < m_recipients.size (); i++)
+        {
+          os << (i == 0 ? "" : ",") << m_recipients[i];
+        }
+    }
+  os << std::endl;
+}
+
+uint32_t
+ProtocolHeader::VarintSize (uint32_t value)
+{
+  uint32_t size = 1;
+  while (value >= 0x80)
+    {
+      value >>= 7;
+      size++;
+    }
+  return size;
+}
+void
+ProtocolHeader::WriteVarint (Buffer::Iterator &i, uint32_t value)
+{
+  while (value >= 0x80)
+    {
+      i.WriteU8 ((uint8_t) (value | 0x80));
+      value >>= 7;
+    }
+  i.WriteU8 ((uint8_t) value);
+}
+uint32_t
+ProtocolHeader::ReadVarint (Buffer::Iterator &i)
 {
-  os << "data=" << m_data << std::endl;
+  uint32_t value = 0;
+  for (uint32_t shift = 0; shift < 35; shift += 7)
+    {
+      uint8_t byte = i.ReadU8 ();
+      value |= (uint32_t) (byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0)
+        break;
+    }
+  return value;
 }
+
 uint32_t
-MyHeader::GetSerializedSize (void) const
+ProtocolHeader::GetSerializedSize (void) const
 {
-  return 2;
+  uint32_t size = 2;
+  if (HasNodeId ())
+    size += VarintSize (m_nodeId);
+  if (m_type != HELLO)
+    size += VarintSize (m_keyNum);
+  if (HasScore ())
+    size += 4;
+  if (HasRecipients ())
+    {
+      size += VarintSize (m_recipients.size ());
+      uint32_t prev = 0;
+      for (uint32_t i = 0; i < m_recipients.size (); i++)
+        {
+          size += VarintSize (m_recipients[i] - prev);
+          prev = m_recipients[i];
+        }
+    }
+  return size;
 }
 void
-MyHeader::Serialize (Buffer::Iterator start) const
+ProtocolHeader::Serialize (Buffer::Iterator start) const
 {
-  start.WriteHtonU16 (m_data);
+  start.WriteU8 ((uint8_t) ((m_version << 4) | (m_type & 0x0f)));
+  start.WriteU8 (m_flags);
+  if (HasNodeId ())
+    WriteVarint (start, m_nodeId);
+  if (m_type != HELLO)
+    WriteVarint (start, m_keyNum);
+  if (HasScore ())
+    {
+      uint32_t bits;
+      memcpy (&bits, &m_score, sizeof (bits));
+      start.WriteHtonU32 (bits);
+    }
+  if (HasRecipients ())
+    {
+      WriteVarint (start, m_recipients.size ());
+      uint32_t prev = 0;
+      for (uint32_t i = 0; i < m_recipients.size (); i++)
+        {
+          WriteVarint (start, m_recipients[i] - prev);
+          prev = m_recipients[i];
+        }
+    }
 }
 uint32_t
-MyHeader::Deserialize (Buffer::Iterator start)
+ProtocolHeader::Deserialize (Buffer::Iterator start)
 {
-  m_data = start.ReadNtohU16 ();
-  return 2;
+  Buffer::Iterator i = start;
+  uint8_t versionType = i.ReadU8 ();
+  m_version = versionType >> 4;
+  m_type = versionType & 0x0f;
+  m_flags = i.ReadU8 ();
+  m_recipients.clear ();
+  //the rest of another version's header cannot be read; ReceivePacket drops it
+  if (m_version != VERSION)
+    {
+      m_flags = 0;
+      m_nodeId = ANY_NODE;
+      m_keyNum = 0;
+      m_score = 0;
+      return i.GetDistanceFrom (start);
+    }
+  m_nodeId = HasNodeId () ? ReadVarint (i) : (uint32_t) ANY_NODE;
+  m_keyNum = m_type != HELLO ? ReadVarint (i) : 0;
+  m_score = 0;
+  if (HasScore ())
+    {
+      uint32_t bits = i.ReadNtohU32 ();
+      memcpy (&m_score, &bits, sizeof (bits));
+    }
+  if (HasRecipients ())
+    {
+      uint32_t count = ReadVarint (i);
+      m_recipients.resize (count);
+      uint32_t prev = 0;
+      for (uint32_t n = 0; n < count; n++)
+        {
+          prev += ReadVarint (i);
+          m_recipients[n] = prev;
+        }
+    }
+  return i.GetDistanceFrom (start);
 }
 
+//false for a header of another version, whose fields were not read
+bool
+ProtocolHeader::IsSupported (void) const
+{
+  return m_version == VERSION;
+}
 void 
-MyHeader::SetData (uint16_t data)
+ProtocolHeader::SetType (uint8_t type)
 {
-  m_data = data;
+  m_type = type;
 }
-uint16_t 
-MyHeader::GetData (void) const
+uint8_t 
+ProtocolHeader::GetType (void) const
+{
+  return m_type;
+}
+void 
+ProtocolHeader::SetNodeId (uint32_t id)
+{
+  m_nodeId = id;
+  if (id == ANY_NODE)
+    m_flags |= FOR_ANY_NODE;
+  else
+    m_flags &= ~FOR_ANY_NODE;
+}
+uint32_t 
+ProtocolHeader::GetNodeId (void) const
+{
+  return m_nodeId;
+}
+bool
+ProtocolHeader::IsForAnyNode (void) const
+{
+  return m_flags & FOR_ANY_NODE;
+}
+bool
+ProtocolHeader::HasNodeId (void) const
+{
+  return (m_flags & (FOR_ANY_NODE | HAS_RECIPIENTS)) == 0;
+}
+void 
+ProtocolHeader::SetKeyNum (uint32_t keyNum)
+{
+  m_keyNum = keyNum;
+}
+uint32_t 
+ProtocolHeader::GetKeyNum (void) const
+{
+  return m_keyNum;
+}
+bool
+ProtocolHeader::HasScore (void) const
+{
+  return m_flags & HAS_SCORE;
+}
+double 
+ProtocolHeader::GetScore (void) const
+{
+  return m_score;
+}
+//a packet with a recipient list is addressed to every node in it
+void 
+ProtocolHeader::SetRecipients (const std::vector<uint32_t> &recipients)
+{
+  m_recipients = recipients;
+  std::sort (m_recipients.begin (), m_recipients.end ());
+  m_flags |= HAS_RECIPIENTS;
+}
+bool
+ProtocolHeader::HasRecipients (void) const
 {
-  return m_data;
+  return m_flags & HAS_RECIPIENTS;
 }
+bool
+ProtocolHeader::IsRecipient (uint32_t id) const
+{
+  return std::binary_search (m_recipients.begin (), m_recipients.end (), id);
+}
+
+class NodeRegistry;
 
 /*****
 *
@@ -350,98 +612,356 @@ class MyReceiver
 {
 
 public: 
-  MyReceiver (Ptr<Node> node, TypeId tid);
+  MyReceiver (SimulationContext *context, Ptr<Node> node, TypeId tid);
   Ptr<Socket> GetSocket ();
-  Ptr<Socket> GetHelloSocket ();
-  Ptr<Socket> GetKeyMsgSocket ();
-  Ptr<Socket> GetFwdSocket ();
   void SetData (std::string m_value);
   std::string GetData ();
-  //virtual ~MyReceiver ();
+  virtual ~MyReceiver ();
   void Bind (InetSocketAddress local);
   void Receive (Callback<void, Ptr<Socket> > ReceivePacket);
   void ReceivePacket (Ptr<Socket> socket);
+  void HandleHello (const ProtocolHeader &header);
+  void AddEncounter (uint32_t id);
+  void HandleMessage (const ProtocolHeader &header);
+  void HandleKey (const ProtocolHeader &header);
+  void HandleForward (const ProtocolHeader &header);
+  void HandleHalf (const ProtocolHeader &header, MatchTable::Half half);
+  bool MatchHalf (uint32_t keyNum, Time t, MatchTable::Half half);
   void Send (Ptr<Packet> msg, Ptr<Socket> socket);
-  void SayHello (uint32_t pktCount, Time pktInterval);
-  void SayMessage (uint32_t pktCount, Time interval, uint16_t recvID, std::vector<MyReceiver* > myReceiverSink);
-  void SayKey (uint32_t pktCount, Time interval, uint16_t recvID, std::vector<MyReceiver* > myReceiverSink);
-  void Forward (uint16_t recvID, uint16_t pktT, uint16_t key);
+  void SayHello ();
+  Time NextBeaconInterval (Time interval);
+  void SayMessage (uint32_t pktCount, Time interval, uint32_t recvID);
+  void SayKey (uint32_t pktCount, Time interval, uint32_t recvID);
+  void StartSource (uint32_t pktCount, Time start, Time delay);
+  void Forward (const std::vector<uint32_t> &recvIDs, uint8_t pktT, uint32_t key);
   Ptr<Node> GetNode ();
-  uint16_t GetCurrKeyNum();
+  uint32_t GetCurrKeyNum();
   void SetMalicious (uint16_t id);
   bool GetMalicious ();
   void SetNeighborNum (uint16_t num);
   uint16_t GetNeighborNum();
-  double NodeAnonymity (std::vector<MyReceiver* > myReceiverSink);
-  void SetNeighbors(ListNode* node);
-  ListNode* GetNeighbors();
+  double NodeAnonymity ();
+  NeighborSet& GetNeighbors();
+  void SetRegistry (NodeRegistry *registry);
+  void SaveState (SnapshotBuffer &buffer);
+  bool LoadState (SnapshotBuffer &buffer);
+  void Stop ();
+  void Reset ();
 
 private:
-  std::vector<uint64_t> messageQ; //integer holds time stamp
-  std::vector<uint64_t> keyQ;
-  std::vector<bool> decodeQ;
+  SimulationContext *context; //the run this node belongs to
+  MatchTable matches; //pending message and key halves, and the keys decoded here
+  SeenCache seen; //packets already considered for forwarding
   std::string m_data;
+  //one broadcast socket per node; received packets are dispatched on their type
+  typedef void (MyReceiver::*PacketHandler) (const ProtocolHeader &header);
+  enum { FORWARD_HANDLER = 3, HANDLER_COUNT = 4 };
+  static const PacketHandler handlers[HANDLER_COUNT];
   Ptr<Socket> mySocket;
-  Ptr<Socket> helloSocket;
-  Ptr<Socket> keyMsgSocket;
-  Ptr<Socket> fwdSocket;
   Ptr<Node> myNode;
   TypeId mytid;
-  uint16_t currentKeyNum;
+  uint32_t currentKeyNum;
   EncounterList *myList;
   bool isMalicious;
   uint16_t neighborNum;
-  ListNode *neighbors;
+  NeighborSet neighbors;
+  NodeRegistry *registry;
+  uint64_t lastChurn; //encounter churn seen at the previous beacon
+  EventId messageEvent; //the next SayMessage of a source
+  EventId keyEvent;
+  bool active; //false between the scenarios of a batch, packets are dropped then
+};
+
+/*****
+*
+* AnonymityTracker caches the anonymity of the nodes that send messages.
+* A cached value is only recomputed after the sender's neighbor set changed,
+* or after the neighbor count of one of its neighbors actually changed.
+*
+*****/
+class AnonymityTracker
+{
+public:
+  AnonymityTracker ();
+  AnonymityTracker (int nodeSize, NodeRegistry *registry);
+  double GetAnonymity (uint32_t id);
+  void NeighborsChanged (uint32_t id);
+  void NeighborNumChanged (uint32_t id);
+  void Reset ();
+private:
+  double Compute (uint32_t id);
+  NodeRegistry *registry;
+  std::vector<double> cachedAnonymity;
+  std::vector<bool> isValid;
+  std::vector<uint32_t> watched; //nodes whose anonymity has been asked for
+};
+
+/*****
+*
+* NodeRegistry is the table of every MyReceiver in the run. It is shared by
+* pointer, so the scheduled send events no longer copy the node list.
+*
+*****/
+class NodeRegistry
+{
+public:
+  NodeRegistry (int nodeSize);
+  void Add (MyReceiver *receiver);
+  MyReceiver* Get (uint32_t id);
+  uint32_t GetSize ();
+  AnonymityTracker& GetTracker ();
+private:
+  std::vector<MyReceiver* > receivers;
+  AnonymityTracker tracker;
+};
+
+AnonymityTracker::AnonymityTracker ()
+{
+}
+
+AnonymityTracker::AnonymityTracker (int nodeSize, NodeRegistry *registry)
+{
+  this -> registry = registry;
+  this -> cachedAnonymity.resize(nodeSize, 0.0);
+  this -> isValid.resize(nodeSize, false);
+}
+
+double
+AnonymityTracker::GetAnonymity (uint32_t id)
+{
+  if (std::find(watched.begin(), watched.end(), id) == watched.end())
+    watched.push_back(id);
+  if (!isValid[id])
+  {
+    cachedAnonymity[id] = Compute(id);
+    isValid[id] = true;
+  }
+  return cachedAnonymity[id];
+}
+
+void
+AnonymityTracker::NeighborsChanged (uint32_t id)
+{
+  isValid[id] = false;
+}
+
+void
+AnonymityTracker::NeighborNumChanged (uint32_t id)
+{
+  for (uint32_t i = 0; i < watched.size(); i++)
+  {
+    uint32_t sender = watched[i];
+    if (isValid[sender] && registry -> Get(sender) -> GetNeighbors().Contains(id))
+      isValid[sender] = false;
+  }
+}
+
+//forget every cached value, for the next scenario of a batch
+void
+AnonymityTracker::Reset ()
+{
+  isValid.assign(isValid.size(), false);
+  watched.clear();
+}
+
+double
+AnonymityTracker::Compute (uint32_t id)
+{
+  NeighborSet &currNeighbors = registry -> Get(id) -> GetNeighbors();
+  double result = 1.0;
+  for (uint32_t i = 0; i < currNeighbors.GetSize(); i++)
+  {
+    MyReceiver *currReceiver = registry -> Get(currNeighbors.Get(i));
+    double neverGuess = 1.0;
+    if (currReceiver -> GetNeighborNum() > 0) {
+      neverGuess = ((double)currReceiver -> GetNeighborNum() - 1)/currReceiver -> GetNeighborNum();
+    }
+    result *= neverGuess; //probability that all the neighbors never guess the source
+  }
+  return 1-result;
+}
+
+NodeRegistry::NodeRegistry (int nodeSize)
+  : receivers(nodeSize, (MyReceiver*) NULL),
+    tracker(nodeSize, this)
+{
+}
+
+void
+NodeRegistry::Add (MyReceiver *receiver)
+{
+  receivers.at(receiver -> GetNode() -> GetId()) = receiver;
+  receiver -> SetRegistry(this);
+}
+
+MyReceiver*
+NodeRegistry::Get (uint32_t id)
+{
+  return this -> receivers.at(id);
+}
+
+uint32_t
+NodeRegistry::GetSize ()
+{
+  return this -> receivers.size();
+}
+
+AnonymityTracker&
+NodeRegistry::GetTracker ()
+{
+  return this -> tracker;
+}
+
+/*****
+*
+* BeaconScheduler sends the hello beacons of every node from one event queue
+* entry. Each node has a phase on a timer wheel with BEACON_WHEEL_SLOTS slots
+* per beacon period. Every tick fires the nodes in the current slot and puts
+* them back one hello interval later, moved by a random jitter so that
+* neighbors do not stay in step. The interval is the period unless the node
+* adapts it (see MyReceiver::NextBeaconInterval); the wheel is long enough
+* for the longest one. Empty slots are skipped. A node stops beaconing once
+* it has used up its budget (0 means no limit).
+*
+*****/
+static const uint32_t BEACON_WHEEL_SLOTS = 100;
+
+class BeaconScheduler
+{
+public:
+  BeaconScheduler (NodeRegistry *registry, Time period, Time maxPeriod, Time jitter, uint32_t budget);
+  void Start (Time start);
+  void Stop ();
+  uint64_t GetBeaconsSent ();
+private:
+  void Tick ();
+  void ScheduleNext ();
+  NodeRegistry *registry;
+  EventId nextTick;
+  int64_t slotWidth; //in nanoseconds
+  uint32_t jitterSlots;
+  uint32_t budget;
+  std::vector<std::vector<uint32_t> > wheel; //longer than any interval plus jitter, so a node never lands in the current round
+  std::vector<uint32_t> remaining; //beacons each node may still send
+  std::vector<int64_t> intervals; //current hello interval of each node, in nanoseconds
+  uint32_t currentSlot;
+  uint64_t beaconsSent;
+  Ptr<UniformRandomVariable> rng;
 };
 
-MyReceiver::MyReceiver (Ptr<Node> node, TypeId tid)
+BeaconScheduler::BeaconScheduler (NodeRegistry *registry, Time period, Time maxPeriod, Time jitter, uint32_t budget)
+{
+  this -> registry = registry;
+  this -> slotWidth = period.GetNanoSeconds() / BEACON_WHEEL_SLOTS;
+  this -> jitterSlots = std::min((uint32_t) (jitter.GetNanoSeconds() / slotWidth), BEACON_WHEEL_SLOTS - 1);
+  this -> budget = budget;
+  uint32_t maxSlots = std::max(period, maxPeriod).GetNanoSeconds() / slotWidth;
+  this -> wheel.resize(maxSlots + jitterSlots + 1);
+  this -> remaining.resize(registry -> GetSize(), budget);
+  this -> intervals.resize(registry -> GetSize(), period.GetNanoSeconds());
+  this -> currentSlot = 0;
+  this -> beaconsSent = 0;
+  this -> rng = CreateObject<UniformRandomVariable> ();
+  this -> rng -> SetStream(BEACON_STREAM);
+}
+
+//spread the first beacon of every node over the first period after start
+void
+BeaconScheduler::Start (Time start)
+{
+  for (uint32_t id = 0; id < registry -> GetSize(); id++)
+  {
+    wheel[rng -> GetInteger(0, BEACON_WHEEL_SLOTS - 1)].push_back(id);
+  }
+  currentSlot = 0;
+  if (wheel[0].empty())
+  {
+    nextTick = Simulator::Schedule (start, &BeaconScheduler::ScheduleNext, this);
+    return;
+  }
+  nextTick = Simulator::Schedule (start, &BeaconScheduler::Tick, this);
+}
+
+void
+BeaconScheduler::Stop ()
+{
+  Simulator::Cancel (nextTick);
+}
+
+void
+BeaconScheduler::Tick ()
+{
+  std::vector<uint32_t> due;
+  due.swap(wheel[currentSlot]);
+  for (uint32_t i = 0; i < due.size(); i++)
+  {
+    uint32_t id = due[i];
+    registry -> Get(id) -> SayHello();
+    beaconsSent++;
+    if (budget > 0 && --remaining[id] == 0)
+      continue;
+    intervals[id] = registry -> Get(id) -> NextBeaconInterval(NanoSeconds(intervals[id])).GetNanoSeconds();
+    uint32_t intervalSlots = std::max((int64_t) 1, intervals[id] / slotWidth);
+    intervalSlots = std::min(intervalSlots, (uint32_t) wheel.size() - jitterSlots - 1);
+    int64_t offset = (int64_t) intervalSlots + rng -> GetInteger(0, 2 * jitterSlots) - jitterSlots;
+    offset = std::max(offset, (int64_t) 1);
+    wheel[(currentSlot + offset) % wheel.size()].push_back(id);
+  }
+  ScheduleNext();
+}
+
+//move to the next slot with a node in it; nothing is scheduled once every budget is spent
+void
+BeaconScheduler::ScheduleNext ()
+{
+  for (uint32_t steps = 1; steps <= wheel.size(); steps++)
+  {
+    uint32_t slot = (currentSlot + steps) % wheel.size();
+    if (!wheel[slot].empty())
+    {
+      currentSlot = slot;
+      nextTick = Simulator::Schedule (NanoSeconds(slotWidth * steps), &BeaconScheduler::Tick, this);
+      return;
+    }
+  }
+}
+
+uint64_t
+BeaconScheduler::GetBeaconsSent ()
+{
+  return this -> beaconsSent;
+}
+
+MyReceiver::MyReceiver (SimulationContext *context, Ptr<Node> node, TypeId tid)
+  : context(context),
+    matches(MilliSeconds(context -> matchWindow)),
+    seen(MilliSeconds(context -> dupWindow)),
+    neighbors(context -> nodeSize)
 {
   this -> currentKeyNum = 1;
-  this -> messageQ.resize(messageCount, 0);
-  this -> keyQ.resize(messageCount, 0);
-  this -> decodeQ.resize(messageCount, false);
+  this -> neighborNum = 0;
+  this -> registry = NULL;
+  this -> lastChurn = 0;
+  this -> active = true;
   this -> myNode = node;
   this -> mytid = tid;
   this -> mySocket = Socket::CreateSocket (node, tid);
-  this -> helloSocket = Socket::CreateSocket (node, tid);
-  this -> keyMsgSocket = Socket::CreateSocket (node, tid);
-  this -> fwdSocket = Socket::CreateSocket (node, tid);
   InetSocketAddress local = InetSocketAddress (Ipv4Address::GetAny (), 80);
   this -> Bind(local);
   InetSocketAddress remote = InetSocketAddress (Ipv4Address ("255.255.255.255"), 80);
   this -> mySocket ->SetAllowBroadcast (true);
-  this -> helloSocket ->SetAllowBroadcast (true);
-  this -> keyMsgSocket ->SetAllowBroadcast (true);
-  this -> fwdSocket ->SetAllowBroadcast (true);
-
   this -> mySocket -> Connect (remote);
-  this -> helloSocket -> Connect (remote);
-  this -> keyMsgSocket -> Connect (remote);
-  this -> fwdSocket -> Connect (remote);
   this -> m_data = "";
-  this -> myList = new EncounterList(nodesize_global, 1/2.0, exp (-4), Time(NanoSeconds(200000000)));//we should test this data
+  this -> myList = new EncounterList(context -> nodeSize, 1/2.0, exp (-4), Seconds(context -> validPeriod));//we should test this data
   this -> SetMalicious (this -> mySocket -> GetNode() -> GetId());
 }
 
-Ptr<Socket>
-MyReceiver::GetHelloSocket ()
-{
-  return this -> helloSocket;
-}
-
-Ptr<Socket>
-MyReceiver::GetKeyMsgSocket ()
-{
-  return this -> keyMsgSocket;
-}
-
-Ptr<Socket>
-MyReceiver::GetFwdSocket ()
+MyReceiver::~MyReceiver ()
 {
-  return this -> fwdSocket;
+  delete this -> myList;
 }
 
-uint16_t
+uint32_t
 MyReceiver::GetCurrKeyNum ()
 {
   return this -> currentKeyNum;
@@ -450,7 +970,7 @@ MyReceiver::GetCurrKeyNum ()
 void
 MyReceiver::SetMalicious (uint16_t id) 
 {
-  if (maliciousVector[id] == true)
+  if (context -> maliciousVector[id] == true)
     this -> isMalicious = true;
   else
     this -> isMalicious = false;
@@ -465,6 +985,8 @@ MyReceiver::GetMalicious ()
 void 
 MyReceiver::SetNeighborNum (uint16_t num) 
 {
+  if (num != this -> neighborNum && this -> registry != NULL)
+    this -> registry -> GetTracker().NeighborNumChanged(this -> myNode -> GetId());
   this -> neighborNum = num;
 }
 
@@ -481,33 +1003,72 @@ MyReceiver::GetNode ()
 }
 
 void
-MyReceiver::SetNeighbors(ListNode* node) 
+MyReceiver::SetRegistry (NodeRegistry *registry)
 {
-  this -> neighbors = node;
+  this -> registry = registry;
 }
 
-ListNode*
-MyReceiver::GetNeighbors() 
+//the encounters, neighbors and match table; the duplicate cache is short lived and starts empty
+void
+MyReceiver::SaveState (SnapshotBuffer &buffer)
 {
-  return this -> neighbors;
+  myList -> Save(buffer);
+  neighbors.Save(buffer);
+  matches.Save(buffer);
 }
 
+//end of a scenario: no more sends, and packets still in flight are dropped
 void
-MyReceiver::Receive (Callback<void, Ptr<Socket> > ReceivePacket)
+MyReceiver::Stop ()
+{
+  Simulator::Cancel (this -> messageEvent);
+  Simulator::Cancel (this -> keyEvent);
+  this -> active = false;
+}
+
+//the state of a fresh node, under the parameters now in context
+void
+MyReceiver::Reset ()
+{
+  this -> matches = MatchTable(MilliSeconds(context -> matchWindow));
+  this -> seen = SeenCache(MilliSeconds(context -> dupWindow));
+  this -> neighbors.Clear();
+  delete this -> myList;
+  this -> myList = new EncounterList(context -> nodeSize, 1/2.0, exp (-4), Seconds(context -> validPeriod));
+  this -> currentKeyNum = 1;
+  this -> neighborNum = 0;
+  this -> lastChurn = 0;
+  this -> SetMalicious (this -> myNode -> GetId());
+  this -> active = true;
+}
+
+bool
+MyReceiver::LoadState (SnapshotBuffer &buffer)
+{
+  if (!myList -> Load(buffer) || !neighbors.Load(buffer, context -> nodeSize) || !matches.Load(buffer, Now()))
+    return false;
+  this -> registry -> GetTracker().NeighborsChanged(this -> myNode -> GetId());
+  this -> SetNeighborNum(this -> neighbors.GetSize());
+  this -> lastChurn = myList -> GetChurn(Now());
+  return true;
+}
+
+NeighborSet&
+MyReceiver::GetNeighbors() 
+{
+  return this -> neighbors;
+}
+
+void
+MyReceiver::Receive (Callback<void, Ptr<Socket> > ReceivePacket)
 {
     this -> mySocket -> SetRecvCallback (ReceivePacket);
-    this -> helloSocket -> SetRecvCallback (ReceivePacket);
-    this -> keyMsgSocket -> SetRecvCallback (ReceivePacket);
-    this -> fwdSocket -> SetRecvCallback (ReceivePacket);
 }
 
 void
 MyReceiver::Bind (InetSocketAddress local)
 {
     this -> mySocket -> Bind (local);
-    this -> helloSocket -> Bind (local);
-    this -> keyMsgSocket -> Bind (local);
-    this -> fwdSocket -> Bind (local);
 }
 
 Ptr<Socket>
@@ -529,6 +1090,25 @@ std::string MyReceiver::GetData()
 
 NS_LOG_COMPONENT_DEFINE ("WifiSimpleAdhoc");
 
+//store one half of keyNum in the match table and count the decode if it completes a match
+bool
+MyReceiver::MatchHalf (uint32_t keyNum, Time t, MatchTable::Half half)
+{
+  if (!matches.Match(keyNum, half, t))
+    return false;
+  context -> metrics.Delivered(keyNum, t);
+  context -> decodes.RecordDecode(keyNum, this -> isMalicious);
+  return true;
+}
+
+//indexed by packet type; frames that carry a recipient list go to HandleForward
+const MyReceiver::PacketHandler MyReceiver::handlers[MyReceiver::HANDLER_COUNT] = {
+  &MyReceiver::HandleHello,
+  &MyReceiver::HandleMessage,
+  &MyReceiver::HandleKey,
+  &MyReceiver::HandleForward
+};
+
 void 
 MyReceiver::ReceivePacket (Ptr<Socket> socket)
 {
@@ -536,267 +1116,515 @@ MyReceiver::ReceivePacket (Ptr<Socket> socket)
   while ( packet = socket->Recv ())
     {
       //packet->Print(std::cout);
-      MyHeader nodeID, packetType;
-      packet -> RemoveHeader(packetType);
-      //NS_LOG_UNCOND ("type: "<< packetType.GetData());
-      packet -> RemoveHeader(nodeID); //for hello message, this is sender. for key message, this is receiver
-      //NS_LOG_UNCOND ("id: "<< nodeID.GetData());
-      
-      //when it is hellomsg Store in Encounter list for score calculation
-      if (packetType.GetData() == (uint16_t) 0) 
-      {
-        Time timestamp = Now();
-        EncounterTuple *newTuple = new EncounterTuple(nodeID.GetData(), timestamp);
-        EncounterListItem *listItem = new EncounterListItem(newTuple);
-        myList -> InsertItem(listItem);
+      if (!this -> active)
+        continue;
+      ProtocolHeader header;
+      packet -> RemoveHeader(header);
+      if (!header.IsSupported())
+        continue;
+      //NS_LOG_UNCOND ("type: "<< (uint32_t) header.GetType());
+      uint32_t handler = header.HasRecipients() ? (uint32_t) FORWARD_HANDLER : header.GetType();
+      if (handler < HANDLER_COUNT) {
+        INSTR_TIME(TIME_RECEIVE);
+        INSTR_COUNT((InstrCounter) (RECEIVE_HELLO + handler), this -> myNode -> GetId());
+        (this ->* handlers[handler]) (header);
       }
-      //if not hellomsg and header id is 999 or itself call forward function
-
-      if (packetType.GetData() != (uint16_t) 0)
-      {
-        MyHeader keyNum;
-        packet -> RemoveHeader(keyNum);
-
-        Time t = Simulator::Now();
-        bool matchFound = false;
-        if (packetType.GetData() == (uint16_t) 1) {
-        //if packet type is message
-        //check for matching key in keyQ by index
-        //if matching key does not exist, then add timestamp to keyQ at index (keyNum)
-          if (keyQ.at(keyNum.GetData()) > 0 && decodeQ.at(keyNum.GetData()) == false) {
-            uint64_t currTime = t.GetMilliSeconds();
-            if (currTime - keyQ.at(keyNum.GetData()) <= 1500) {
-              matchFound = true;
-              decodeQ.at(keyNum.GetData()) = true;
-              if (messageReceivedTime.at(keyNum.GetData()) == (uint64_t) 0) {
-                messageReceivedTime.at(keyNum.GetData()) = currTime;
-                NS_LOG_UNCOND ("Message Sent time "<<messageSendTime.at(keyNum.GetData()));
-                NS_LOG_UNCOND ("Message Received Time"<<messageReceivedTime.at(keyNum.GetData()));
-              }
-              if (this -> isMalicious) {
-                if (std::find(m_decodeQ.begin(), m_decodeQ.end(), keyNum.GetData()) == m_decodeQ.end()) {
-                  m_decodeQ.push_back(keyNum.GetData());
-                }
-                NS_LOG_UNCOND ("Matched by Mal");
-              }
-              else {
-                if (std::find(g_decodeQ.begin(), g_decodeQ.end(), keyNum.GetData()) == g_decodeQ.end()) {
-                  g_decodeQ.push_back(keyNum.GetData());
-                }
-              }
-              if (std::find(gTotalDecode.begin(), gTotalDecode.end(), keyNum.GetData()) == gTotalDecode.end()) {
-                  gTotalDecode.push_back(keyNum.GetData());
-              }
-              NS_LOG_UNCOND ("Match Found by: " << this -> mySocket ->GetNode() -> GetId());
-              NS_LOG_UNCOND ("Match Key Num: " <<keyNum.GetData());
-            }
-          }
-          else {
-            messageQ.at(keyNum.GetData()) = t.GetMilliSeconds();
-            //NS_LOG_UNCOND ("messageQ: "<<messageQ.at(keyNum.GetData()));
-          }
-        }
-        //if received key
-        if (packetType.GetData() == (uint16_t) 2) {
-          //if there's a matching message
-          if (messageQ.at(keyNum.GetData()) > 0 && decodeQ.at(keyNum.GetData()) == false) {
-            uint64_t currTime = t.GetMilliSeconds();
-            if (currTime - messageQ.at(keyNum.GetData()) <= 1500) {
-              matchFound = true;
-              decodeQ.at(keyNum.GetData()) = true;
-              if (messageReceivedTime.at(keyNum.GetData()) == (uint64_t) 0) {
-                messageReceivedTime.at(keyNum.GetData()) = currTime;
-                NS_LOG_UNCOND ("Message Sent time "<<messageSendTime.at(keyNum.GetData()));
-                NS_LOG_UNCOND ("Message Received Time"<<messageReceivedTime.at(keyNum.GetData()));
-              }
-              if (this -> isMalicious) {
-                if (std::find(m_decodeQ.begin(), m_decodeQ.end(), keyNum.GetData()) == m_decodeQ.end()) {
-                  m_decodeQ.push_back(keyNum.GetData());
-                }
-                NS_LOG_UNCOND ("Matched by Mal");
-              }
-              else {
-                if (std::find(g_decodeQ.begin(), g_decodeQ.end(), keyNum.GetData()) == g_decodeQ.end()) {
-                  g_decodeQ.push_back(keyNum.GetData());
-                }
-              }
-              if (std::find(gTotalDecode.begin(), gTotalDecode.end(), keyNum.GetData()) == gTotalDecode.end()) {
-                  gTotalDecode.push_back(keyNum.GetData());
-              }
-              NS_LOG_UNCOND ("Match Found by: " << this -> mySocket ->GetNode() -> GetId());
-              NS_LOG_UNCOND ("Match Key Num: " <<keyNum.GetData());
-            }
-          }
-          //if no matching key
-          else {
-            keyQ.at(keyNum.GetData()) = t.GetMilliSeconds();
-            //NS_LOG_UNCOND ("keyQ: "<<keyQ.at(keyNum.GetData()));
-          }
-        }
-        if (nodeID.GetData() == (uint16_t) 999 || 
-            nodeID.GetData() == this -> mySocket ->GetNode () -> GetId ())
-        {    
-          if (!matchFound && !decodeQ.at(keyNum.GetData())) {
-            ////NS_LOG_UNCOND ("want to calculate the score"); 
-            Time time = Now();
-            //while we calculate max score, we also update numbers of our neighbors and all the neighbors;
-            uint16_t currNeighborNum = 0;
-            ListNode *currNeighbors = new ListNode(-1);
-            std::vector<uint32_t> bunch_of_recvID = myList -> calculateMaxScore(nodesize_global, time, threshold_global, currNeighborNum, currNeighbors);
-            this -> SetNeighborNum(currNeighborNum);
-            this -> SetNeighbors(currNeighbors -> next);
-
-            for (int i = 0; i < (int) bunch_of_recvID.size(); i++) {
-              this -> Forward (bunch_of_recvID[(uint32_t)i], packetType.GetData(), keyNum.GetData());
-            }
-          }
-        }
-      }
-     
     }
 } 
 
+//when it is hellomsg Store in Encounter list for score calculation
+void
+MyReceiver::HandleHello (const ProtocolHeader &header)
+{
+  this -> AddEncounter(header.GetNodeId()); //for hello message, the node id is the sender
+}
+
+//id was heard just now, by a hello or by the EncounterSampler
+void
+MyReceiver::AddEncounter (uint32_t id)
+{
+  Time timestamp = Now();
+  myList -> InsertItem(id, timestamp);
+  INSTR_SIZE(myList -> GetSize());
+}
+
+void
+MyReceiver::HandleMessage (const ProtocolHeader &header)
+{
+  this -> HandleHalf(header, MatchTable::MESSAGE);
+}
+
+void
+MyReceiver::HandleKey (const ProtocolHeader &header)
+{
+  this -> HandleHalf(header, MatchTable::KEY);
+}
+
+void
+MyReceiver::HandleForward (const ProtocolHeader &header)
+{
+  if (header.GetType() == ProtocolHeader::MESSAGE)
+    this -> HandleHalf(header, MatchTable::MESSAGE);
+  else if (header.GetType() == ProtocolHeader::KEY)
+    this -> HandleHalf(header, MatchTable::KEY);
+}
+
+//match a message or key, then forward it if it is for any node, for this node or lists it as a next hop
+void
+MyReceiver::HandleHalf (const ProtocolHeader &header, MatchTable::Half half)
+{
+  uint32_t nodeID = header.GetNodeId(); //the receiver
+  uint32_t keyNum = header.GetKeyNum();
+  uint32_t myId = this -> myNode -> GetId ();
+
+  Time t = Simulator::Now();
+  //a message is matched against a stored key and a key against a stored message
+  bool matchFound = this -> MatchHalf(keyNum, t, half);
+
+  bool addressedToMe;
+  if (header.HasRecipients())
+    addressedToMe = header.IsRecipient(myId);
+  else
+    addressedToMe = header.IsForAnyNode() || nodeID == myId;
+  if (!addressedToMe)
+    return;
+
+  uint32_t target = header.HasRecipients() ? myId : nodeID;
+  if (!matchFound && !matches.IsDecoded(keyNum) &&
+      !seen.CheckAndInsert(header.GetType(), keyNum, target, t)) {
+    ////NS_LOG_UNCOND ("want to calculate the score"); 
+    //while we calculate max score, we also update numbers of our neighbors and all the neighbors;
+    std::vector<uint32_t> bunch_of_recvID;
+    {
+      INSTR_TIME(TIME_MAX_SCORE);
+      bunch_of_recvID = myList -> calculateMaxScore(t, context -> threshold, this -> neighbors);
+    }
+    INSTR_COUNT(FORWARD_DECISIONS, myId);
+    this -> registry -> GetTracker().NeighborsChanged(myId);
+    this -> SetNeighborNum(this -> neighbors.GetSize());
+
+    if (!bunch_of_recvID.empty()) {
+      INSTR_COUNT(FORWARD_CALLS, myId);
+      INSTR_ADD(FORWARD_RECIPIENTS, myId, bunch_of_recvID.size());
+      this -> Forward (bunch_of_recvID, header.GetType(), keyNum);
+    }
+  }
+}
+
 void MyReceiver::Send (Ptr<Packet> msg, Ptr<Socket> socket)
 {
+  INSTR_TIME(TIME_SEND);
   socket -> Send(msg);
 }
 
-void MyReceiver::SayHello (uint32_t pktCount, Time interval)
+/*
+* In adaptive beaconing mode the hello interval halves whenever a neighbor
+* appeared in or expired from the encounter list since the last beacon, and
+* grows by a quarter while the neighborhood stays the same, within
+* [beaconMin, beaconMax]. Otherwise the interval is left as it is.
+*/
+Time MyReceiver::NextBeaconInterval (Time interval)
+{
+  if (!context -> adaptiveBeacon)
+    return interval;
+  uint64_t churn = myList -> GetChurn(Now());
+  int64_t next = interval.GetNanoSeconds();
+  if (churn != this -> lastChurn)
+    next /= 2;
+  else
+    next += next / 4;
+  this -> lastChurn = churn;
+  next = std::max(next, Seconds(context -> beaconMin).GetNanoSeconds());
+  next = std::min(next, Seconds(context -> beaconMax).GetNanoSeconds());
+  return NanoSeconds(next);
+}
+
+//sends one hello; the BeaconScheduler decides when
+void MyReceiver::SayHello ()
 {
-  MyHeader encHeader;
-  encHeader.SetData(this -> mySocket ->GetNode () -> GetId ());
-  MyHeader packetType;
-  packetType.SetData((uint16_t) 0);
+  ProtocolHeader header;
+  header.SetType(ProtocolHeader::HELLO);
+  header.SetNodeId(this -> mySocket ->GetNode () -> GetId ());
   Ptr<Packet> helloMsg = Create<Packet> (100);
-  helloMsg -> AddHeader(encHeader);
-  helloMsg -> AddHeader(packetType);
-  Ptr<Packet> emptyMsg = Create<Packet> ();
-  this -> Send (emptyMsg, this -> helloSocket);
-  this -> Send (helloMsg, this -> helloSocket);
-  EventId sendEvent;
-  sendEvent = Simulator::Schedule (interval, &MyReceiver::SayHello, this, pktCount-1, interval);
-  ////NS_LOG_UNCOND (sendEvent.GetTs());
+  helloMsg -> AddHeader(header);
+  this -> Send (helloMsg, this -> mySocket);
+  INSTR_COUNT(SEND_HELLO, this -> myNode -> GetId());
 }
 
-void MyReceiver::SayMessage (uint32_t pktCount, Time interval, uint16_t recvID, std::vector<MyReceiver* > myReceiverSink)
+void MyReceiver::SayMessage (uint32_t pktCount, Time interval, uint32_t recvID)
 {
-  MyHeader idHeader;
-  idHeader.SetData(recvID);
-  MyHeader msgKeyNum;
-  msgKeyNum.SetData(this -> currentKeyNum);
-  MyHeader packetType;
-  packetType.SetData((uint16_t) 1);
+  ProtocolHeader header;
+  header.SetType(ProtocolHeader::MESSAGE);
+  header.SetNodeId(recvID);
+  header.SetKeyNum(this -> currentKeyNum);
   Ptr<Packet> encMsg = Create<Packet> (100);
-  encMsg -> AddHeader(msgKeyNum);
-  encMsg -> AddHeader(idHeader);
-  encMsg -> AddHeader(packetType);
-  this -> Send (encMsg, this -> keyMsgSocket);
-  rawTotalSent++;
-  anonymityTotal += this->NodeAnonymity(myReceiverSink);
+  encMsg -> AddHeader(header);
+  this -> Send (encMsg, this -> mySocket);
+  INSTR_COUNT(SEND_MESSAGE, this -> myNode -> GetId());
+  context -> rawTotalSent++;
+  context -> anonymityTotal += this->NodeAnonymity();
   //record the message sending time
-  if (messageSendTime.at(currentKeyNum) == 0.0)
-    messageSendTime.at(currentKeyNum) = Simulator::Now().GetMilliSeconds();
+  context -> metrics.MessageSent(currentKeyNum, Simulator::Now());
   
-  EventId sendEvent;
-  sendEvent = Simulator::Schedule (interval, &MyReceiver::SayMessage, this, pktCount-1, interval, recvID, myReceiverSink);
+  this -> messageEvent = Simulator::Schedule (interval, &MyReceiver::SayMessage, this, pktCount-1, interval, recvID);
   //sendEvent = Simulator::Schedule (pktInterval, &MyReceiver::SayHello, this, pktCount-1, pktInterval);
   //NS_LOG_UNCOND (sendEvent.GetTs());
 }
 
-void MyReceiver::SayKey(uint32_t pktCount, Time interval, uint16_t recvID, std::vector<MyReceiver* > myReceiverSink)
+void MyReceiver::SayKey(uint32_t pktCount, Time interval, uint32_t recvID)
 {
-  MyHeader idHeader;
-  idHeader.SetData(recvID);
-  MyHeader msgKeyNum;
-  msgKeyNum.SetData(this -> currentKeyNum);
-  MyHeader packetType;
-  packetType.SetData((uint16_t) 2);
+  ProtocolHeader header;
+  header.SetType(ProtocolHeader::KEY);
+  header.SetNodeId(recvID);
+  header.SetKeyNum(this -> currentKeyNum);
   Ptr<Packet> keyMsg = Create<Packet> (100);
-  keyMsg -> AddHeader(msgKeyNum);
-  keyMsg -> AddHeader(idHeader);
-  keyMsg -> AddHeader(packetType);
-  this -> Send (keyMsg, this -> keyMsgSocket);
-  gTotalSent=currentKeyNum;
-  rawTotalSent++;
-  anonymityTotal += this->NodeAnonymity(myReceiverSink);
+  keyMsg -> AddHeader(header);
+  this -> Send (keyMsg, this -> mySocket);
+  INSTR_COUNT(SEND_KEY, this -> myNode -> GetId());
+  context -> gTotalSent=currentKeyNum;
+  context -> metrics.KeySent(currentKeyNum, Simulator::Now());
+  context -> rawTotalSent++;
+  context -> anonymityTotal += this->NodeAnonymity();
   this -> currentKeyNum++;
 
-  EventId sendEvent;
-  sendEvent = Simulator::Schedule (interval, &MyReceiver::SayKey, this, pktCount-1, interval, recvID, myReceiverSink);
+  this -> keyEvent = Simulator::Schedule (interval, &MyReceiver::SayKey, this, pktCount-1, interval, recvID);
   ////NS_LOG_UNCOND (sendEvent.GetTs());
 }
 
-void MyReceiver::Forward (uint16_t recvID, uint16_t pktT, uint16_t key) 
+//first message at start and first key delay later; Stop cancels them even before they fire
+void MyReceiver::StartSource (uint32_t pktCount, Time start, Time delay)
 {
-  //NS_LOG_UNCOND ("forward to" << recvID);
-  MyHeader rcv, pktType, keyNum;
-  rcv.SetData(recvID);
-  pktType.SetData(pktT);
-  keyNum.SetData(key);
+  this -> messageEvent = Simulator::Schedule (start, &MyReceiver::SayMessage, this, pktCount, start, ProtocolHeader::ANY_NODE);
+  this -> keyEvent = Simulator::Schedule (start + delay, &MyReceiver::SayKey, this, pktCount, start + delay, ProtocolHeader::ANY_NODE);
+}
+
+//one broadcast carries every chosen next hop; nodes in the list act on it as if it was addressed to them
+void MyReceiver::Forward (const std::vector<uint32_t> &recvIDs, uint8_t pktT, uint32_t key) 
+{
+  //NS_LOG_UNCOND ("forward to " << recvIDs.size() << " nodes");
+  ProtocolHeader header;
+  header.SetType(pktT);
+  header.SetKeyNum(key);
+  header.SetRecipients(recvIDs);
   Ptr<Packet> msg = Create<Packet> (100);
-  msg -> AddHeader(keyNum);
-  msg -> AddHeader(rcv);
-  msg -> AddHeader(pktType);
-  this -> Send (msg, this -> fwdSocket);
+  msg -> AddHeader(header);
+  this -> Send (msg, this -> mySocket);
+  INSTR_COUNT(SEND_FORWARD, this -> myNode -> GetId());
+  context -> metrics.Forwarded(this -> myNode -> GetId());
+}
+
+double MyReceiver::NodeAnonymity () {
+    INSTR_TIME(TIME_ANONYMITY);
+    return this -> registry -> GetTracker().GetAnonymity(this -> myNode -> GetId());
+}
+
+
+static const double RADIO_RANGE = 10.0; //meters, the RangePropagationLossModel MaxRange
+static const double WALK_STEP = 1.0; //meters a random walk goes before it changes course
+static const double SPEED_OF_LIGHT = 299792458.0; //meters per second
+
+/*
+* GridRangeChannel delivers a broadcast to every device within range of the
+* sender, like a YansWifiChannel with a RangePropagationLossModel, but only
+* looks at devices in the 3x3 grid cells around the sender instead of all of
+* them. A device is bucketed by the position of its last mobility course
+* change, so it may have drifted up to maxDrift from its bucket; cells are
+* range + maxDrift wide, which keeps every device in range within the 3x3
+* cells. Mobility that changes course less often than every maxDrift meters,
+* such as a replayed trace, needs SetRebucket to rebucket every device often
+* enough instead. Devices get their frame after the speed of light
+* propagation delay, or after a fixed latency if SetLatency gave one.
+* The devices are SimpleNetDevices, so there is no MAC contention, no
+* collisions and no PHY loss: it models the same range as the 802.11b stack,
+* not the same link, and its results are not comparable with wifi runs.
+*/
+class GridRangeChannel : public SimpleChannel
+{
+public:
+  GridRangeChannel (double range, double maxDrift);
+  void SetLatency (Time latency);
+  void SetRebucket (Time period);
+  virtual void Add (Ptr<SimpleNetDevice> device);
+  virtual void Send (Ptr<Packet> p, uint16_t protocol, Mac48Address to, Mac48Address from,
+                     Ptr<SimpleNetDevice> sender);
+  static uint64_t CellKey (int32_t x, int32_t y);
+private:
+  void BuildIndex ();
+  void CourseChanged (Ptr<const MobilityModel> mobility);
+  void Move (uint32_t index, Vector position);
+  void Rebucket ();
+  int32_t CellCoordinate (double x);
+  uint64_t CellOf (Vector position);
+  double range;
+  double cellSize;
+  Time latency; //zero for the propagation delay
+  Time rebucket; //zero to rebucket on course changes only
+  bool indexed; //mobility is installed after the devices, so the index is built on the first send
+  std::vector<Ptr<SimpleNetDevice> > devices;
+  std::vector<Ptr<MobilityModel> > mobilities;
+  std::vector<uint64_t> cellOfDevice;
+  std::map<uint32_t, uint32_t> deviceOfNode;
+  std::map<uint64_t, std::vector<uint32_t> > cells; //device indices by cell
+};
+
+GridRangeChannel::GridRangeChannel (double range, double maxDrift)
+{
+  this -> range = range;
+  this -> cellSize = range + maxDrift;
+  this -> latency = Seconds (0);
+  this -> rebucket = Seconds (0);
+  this -> indexed = false;
+}
+
+void
+GridRangeChannel::SetLatency (Time latency)
+{
+  this -> latency = latency;
+}
+
+void
+GridRangeChannel::SetRebucket (Time period)
+{
+  this -> rebucket = period;
+}
+
+void
+GridRangeChannel::Add (Ptr<SimpleNetDevice> device)
+{
+  SimpleChannel::Add (device);
+  this -> devices.push_back (device);
+}
+
+int32_t
+GridRangeChannel::CellCoordinate (double x)
+{
+  return (int32_t) floor (x / cellSize);
 }
 
-double MyReceiver::NodeAnonymity (std::vector<MyReceiver* > myReceiverSink) {
-    ListNode *node = GetNeighbors();
-    double result = 1.0;
-    while (node != NULL) 
+uint64_t
+GridRangeChannel::CellKey (int32_t x, int32_t y)
+{
+  return ((uint64_t) (uint32_t) x << 32) | (uint32_t) y;
+}
+
+uint64_t
+GridRangeChannel::CellOf (Vector position)
+{
+  return CellKey (CellCoordinate (position.x), CellCoordinate (position.y));
+}
+
+void
+GridRangeChannel::BuildIndex ()
+{
+  for (uint32_t i = 0; i < devices.size (); i++)
+  {
+    Ptr<MobilityModel> mobility = devices[i] -> GetNode () -> GetObject<MobilityModel> ();
+    NS_ASSERT_MSG (mobility, "GridRangeChannel needs a mobility model on every node");
+    mobility -> TraceConnectWithoutContext ("CourseChange", MakeCallback (&GridRangeChannel::CourseChanged, this));
+    uint64_t cell = CellOf (mobility -> GetPosition ());
+    mobilities.push_back (mobility);
+    cellOfDevice.push_back (cell);
+    deviceOfNode[devices[i] -> GetNode () -> GetId ()] = i;
+    cells[cell].push_back (i);
+  }
+  this -> indexed = true;
+  if (rebucket.IsStrictlyPositive ())
+    Simulator::Schedule (rebucket, &GridRangeChannel::Rebucket, this);
+}
+
+void
+GridRangeChannel::CourseChanged (Ptr<const MobilityModel> mobility)
+{
+  Move (deviceOfNode[mobility -> GetObject<Node> () -> GetId ()], mobility -> GetPosition ());
+}
+
+void
+GridRangeChannel::Rebucket ()
+{
+  for (uint32_t i = 0; i < mobilities.size (); i++)
+    Move (i, mobilities[i] -> GetPosition ());
+  Simulator::Schedule (rebucket, &GridRangeChannel::Rebucket, this);
+}
+
+//move a device to its new cell; within a cell the order does not matter
+void
+GridRangeChannel::Move (uint32_t index, Vector position)
+{
+  uint64_t cell = CellOf (position);
+  if (cell == cellOfDevice[index])
+    return;
+  std::vector<uint32_t> &old = cells[cellOfDevice[index]];
+  std::vector<uint32_t>::iterator it = std::find (old.begin (), old.end (), index);
+  *it = old.back ();
+  old.pop_back ();
+  cells[cell].push_back (index);
+  cellOfDevice[index] = cell;
+}
+
+void
+GridRangeChannel::Send (Ptr<Packet> p, uint16_t protocol, Mac48Address to, Mac48Address from,
+                        Ptr<SimpleNetDevice> sender)
+{
+  if (!indexed)
+    BuildIndex ();
+  Vector origin = sender -> GetNode () -> GetObject<MobilityModel> () -> GetPosition ();
+  int32_t x = CellCoordinate (origin.x);
+  int32_t y = CellCoordinate (origin.y);
+  for (int32_t dx = -1; dx <= 1; dx++)
+    for (int32_t dy = -1; dy <= 1; dy++)
     {
-      MyReceiver *currReceiver = myReceiverSink.at(node -> val); 
-      double neverGuess = 1.0;
-      if (currReceiver -> GetNeighborNum() > 0) {
-        neverGuess = ((double)currReceiver -> GetNeighborNum() - 1)/currReceiver -> GetNeighborNum();
+      std::map<uint64_t, std::vector<uint32_t> >::iterator cell = cells.find (CellKey (x + dx, y + dy));
+      if (cell == cells.end ())
+        continue;
+      for (uint32_t i = 0; i < cell -> second.size (); i++)
+      {
+        uint32_t index = cell -> second[i];
+        if (devices[index] == sender)
+          continue;
+        double distance = CalculateDistance (origin, mobilities[index] -> GetPosition ());
+        if (distance > range)
+          continue;
+        Time delay = latency.IsZero () ? Seconds (distance / SPEED_OF_LIGHT) : latency;
+        Simulator::ScheduleWithContext (devices[index] -> GetNode () -> GetId (), delay,
+                                        &SimpleNetDevice::Receive, devices[index], p -> Copy (), protocol, to, from);
       }
-      result *= neverGuess; //probability that all the neighbors never guess the source
-      node = node -> next;
     }
-    return 1-result;
 }
 
+/*
+* The ideal disc link layer: every node within RADIO_RANGE gets a frame after
+* a fixed latency, the sender serializes frames at a fixed rate and a receiver
+* loses each frame independently with probability linkLoss. There is no
+* contention, so a run costs a fraction of the 802.11b stack. The devices sit
+* under the same internet stack, so MyReceiver keeps its UDP sockets.
+*/
+static NetDeviceContainer InstallDisc (SimulationContext &ctx, NodeContainer &c, Time rebucket)
+{
+  Ptr<GridRangeChannel> channel = CreateObject<GridRangeChannel> (RADIO_RANGE, WALK_STEP);
+  channel -> SetRebucket (rebucket);
+  channel -> SetLatency (MicroSeconds (ctx.linkLatency * 1000));
+  SimpleNetDeviceHelper simple;
+  simple.SetDeviceAttribute ("DataRate", DataRateValue (DataRate (ctx.linkRate)));
+  NetDeviceContainer devices = simple.Install (c, channel);
+  if (ctx.linkLoss > 0)
+    for (uint32_t i = 0; i < devices.GetN (); i++)
+    {
+      Ptr<RateErrorModel> loss = CreateObject<RateErrorModel> ();
+      loss -> SetUnit (RateErrorModel::ERROR_UNIT_PACKET);
+      loss -> SetRate (ctx.linkLoss);
+      loss -> AssignStreams (LOSS_STREAM + i);
+      devices.Get (i) -> SetAttribute ("ReceiveErrorModel", PointerValue (loss));
+    }
+  return devices;
+}
 
-int main (int argc, char *argv[])
+/*****
+*
+* EncounterSampler is the analytic encounter mode. Instead of every node
+* sending hello beacons, it reads the position of every node once per beacon
+* period, puts the nodes in a cell list with cells of RADIO_RANGE and records
+* an encounter in both EncounterLists for every pair in range. Only the 3x3
+* cells around a node can hold a node in range. Messages and keys still go
+* through the link layer.
+*
+*****/
+class EncounterSampler
 {
-  std::cout<< "input arguments in the following sequence, number of nodes, node density, nodes speed, malicious node percentage, message count, broadcast threshold, source moving delay" << std::endl;
-  //input arguments in the following sequence, number of nodes, node density, nodes speed, malicious node percentage, message count, broadcast threshold, source moving delay
-  int nodeSparseness = 30;
-  int nodeTravel = 300;
-  int nodeSpeed = 100.0;
-  int movingDelay = 3;
-  int sourceNode = 2;
-  CommandLine cmd;
-  cmd.AddValue ("nodeSize", "number of nodes (default 50)", nodesize_global);
-  cmd.AddValue ("nodeSparseness", "density of the network (default 10)", nodeSparseness);
-  cmd.AddValue ("nodeTravel", "how far a node will travel (default 300)", nodeTravel);
-  cmd.AddValue ("nodeSpeed", "speed of each node (default 100.0)", nodeSpeed);
-  cmd.AddValue ("maliRatio", "percentage of malicious nodes (default 0.5)", maliRatio);
-//  cmd.AddValue ("messageCount", "total number of message the source node sends", messageCount);
-  cmd.AddValue ("threshold", "threshold for every node to broadcast (default 1.0)", threshold_global);
-  cmd.AddValue ("delay", "the time period between sending message and key (default 3)", movingDelay);
-  cmd.AddValue ("sourceNode", "the node chosen to be the source (default 2)", sourceNode);
-  cmd.Parse (argc, argv);
+public:
+  EncounterSampler (NodeRegistry *registry, NodeContainer &nodes, double range, Time period);
+  void Start (Time start);
+  void Stop ();
+  uint64_t GetEncounters ();
+private:
+  void Sample ();
+  int32_t CellCoordinate (double x);
+  NodeRegistry *registry;
+  EventId nextSample;
+  std::vector<Ptr<MobilityModel> > mobilities;
+  double range;
+  Time period;
+  std::vector<Vector> positions;
+  std::map<uint64_t, std::vector<uint32_t> > cells; //node ids by cell, rebuilt every sample
+  uint64_t encounters;
+};
 
+EncounterSampler::EncounterSampler (NodeRegistry *registry, NodeContainer &nodes, double range, Time period)
+{
+  this -> registry = registry;
+  this -> range = range;
+  this -> period = period;
+  this -> encounters = 0;
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    this -> mobilities.push_back (nodes.Get (i) -> GetObject<MobilityModel> ());
+  this -> positions.resize (nodes.GetN ());
+}
 
-  //arguments for packets
-  std::string phyMode ("DsssRate1Mbps");
-  uint32_t numPackets = 10;
-  bool verbose = false;
-  
-  //initialize maliciousVector
-  int maliNumber = maliRatio * nodesize_global;
-  int maliCount = 0;
-  while (maliCount < maliNumber) {
-    int randIdx = rand() % nodesize_global;
-    if (maliciousVector[randIdx] == false) {
-      maliciousVector[randIdx] = true;
-      maliCount++;
-    }
+void
+EncounterSampler::Start (Time start)
+{
+  nextSample = Simulator::Schedule (start, &EncounterSampler::Sample, this);
+}
+
+void
+EncounterSampler::Stop ()
+{
+  Simulator::Cancel (nextSample);
+}
+
+int32_t
+EncounterSampler::CellCoordinate (double x)
+{
+  return (int32_t) floor (x / range);
+}
+
+void
+EncounterSampler::Sample ()
+{
+  std::map<uint64_t, std::vector<uint32_t> >::iterator cell;
+  for (cell = cells.begin (); cell != cells.end (); ++cell)
+    cell -> second.clear ();
+  for (uint32_t i = 0; i < mobilities.size (); i++)
+  {
+    positions[i] = mobilities[i] -> GetPosition ();
+    cells[GridRangeChannel::CellKey (CellCoordinate (positions[i].x), CellCoordinate (positions[i].y))].push_back (i);
+  }
+  //each pair is found from its lower id, and both ends hear each other
+  for (uint32_t i = 0; i < mobilities.size (); i++)
+  {
+    int32_t x = CellCoordinate (positions[i].x);
+    int32_t y = CellCoordinate (positions[i].y);
+    for (int32_t dx = -1; dx <= 1; dx++)
+      for (int32_t dy = -1; dy <= 1; dy++)
+      {
+        cell = cells.find (GridRangeChannel::CellKey (x + dx, y + dy));
+        if (cell == cells.end ())
+          continue;
+        for (uint32_t k = 0; k < cell -> second.size (); k++)
+        {
+          uint32_t j = cell -> second[k];
+          if (j <= i || CalculateDistance (positions[i], positions[j]) > range)
+            continue;
+          registry -> Get(i) -> AddEncounter(j);
+          registry -> Get(j) -> AddEncounter(i);
+          encounters++;
+        }
+      }
   }
+  nextSample = Simulator::Schedule (period, &EncounterSampler::Sample, this);
+}
 
-  // Convert to time object
-  Time interPacketInterval = Seconds (movingDelay);
+//pairs in range summed over every sample
+uint64_t
+EncounterSampler::GetEncounters ()
+{
+  return this -> encounters;
+}
+
+//the 802.11b adhoc NICs the scenario was built with
+static NetDeviceContainer InstallWifi (NodeContainer &c)
+{
+  std::string phyMode ("DsssRate1Mbps");
+  bool verbose = false;
 
   // disable fragmentation for frames below 2200 bytes
   Config::SetDefault ("ns3::WifiRemoteStationManager::FragmentationThreshold", StringValue ("2200"));
@@ -806,8 +1634,6 @@ int main (int argc, char *argv[])
   Config::SetDefault ("ns3::WifiRemoteStationManager::NonUnicastMode", 
                       StringValue (phyMode));
         
-  c.Create (nodesize_global);
-
   // The below set of helpers will help us to put together the wifi NICs we want
   WifiHelper wifi;
   if (verbose)
@@ -827,7 +1653,7 @@ int main (int argc, char *argv[])
   wifiChannel.SetPropagationDelay ("ns3::ConstantSpeedPropagationDelayModel");
   // The below FixedRssLossModel will cause the rss to be fixed regardless
   // of the distance between the two stations, and the transmit power
-   wifiChannel.AddPropagationLoss ("ns3::RangePropagationLossModel","MaxRange",DoubleValue (10.0));
+   wifiChannel.AddPropagationLoss ("ns3::RangePropagationLossModel","MaxRange",DoubleValue (RADIO_RANGE));
   wifiPhy.SetChannel (wifiChannel.Create ());
 
   // Add a non-QoS upper mac, and disable rate control
@@ -838,7 +1664,26 @@ int main (int argc, char *argv[])
   // Set it to adhoc mode
   wifiMac.SetType ("ns3::AdhocWifiMac");
   NetDeviceContainer devices = wifi.Install (wifiPhy, wifiMac, c);
+  wifi.AssignStreams (devices, WIFI_STREAM);
+  return devices;
+}
 
+//start positions in a disc around (100, 100), on fixed streams so a batch scenario starts where a single run would
+static Ptr<RandomDiscPositionAllocator> StartPositions (SimulationContext &ctx)
+{
+  char rho[50];
+  sprintf(rho, "ns3::UniformRandomVariable[Min=0|Max=%d]",ctx.nodeSparseness);
+  Ptr<RandomDiscPositionAllocator> positions = CreateObject<RandomDiscPositionAllocator> ();
+  positions -> SetAttribute ("X", StringValue ("100.0"));
+  positions -> SetAttribute ("Y", StringValue ("100.0"));
+  positions -> SetAttribute ("Rho", StringValue (rho));
+  positions -> AssignStreams (POSITION_STREAM);
+  return positions;
+}
+
+//the random walk around (100, 100) the scenario was built with
+static void InstallRandomWalk (SimulationContext &ctx, NodeContainer &c)
+{
   // Note that with FixedRssLossModel, the positions below are not 
   // used for received signal strength. 
   MobilityHelper mobility;
@@ -846,20 +1691,247 @@ int main (int argc, char *argv[])
   positionAlloc->Add (Vector (0.0, 0.0, 0.0));
   positionAlloc->Add (Vector (5.0, 0.0, 0.0));
   //mobility.SetPositionAllocator (positionAlloc);
-  char rho[50];
-  sprintf(rho, "ns3::UniformRandomVariable[Min=0|Max=%d]",nodeSparseness);
-  
-  mobility.SetPositionAllocator ("ns3::RandomDiscPositionAllocator",
-  "X", StringValue ("100.0"),
-  "Y", StringValue ("100.0"),
-  "Rho", StringValue (rho));
+  mobility.SetPositionAllocator (StartPositions (ctx));
   char speed[45];
-  sprintf(speed, "ns3::ConstantRandomVariable[Constant=%d]",nodeSpeed);
+  sprintf(speed, "ns3::ConstantRandomVariable[Constant=%d]",ctx.nodeSpeed);
   mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
-                             "Bounds", RectangleValue (Rectangle (0-nodeTravel, nodeTravel, 0-nodeTravel, nodeTravel)),
-                             "Distance", DoubleValue (1.0),
+                             "Bounds", RectangleValue (Rectangle (0-ctx.nodeTravel, ctx.nodeTravel, 0-ctx.nodeTravel, ctx.nodeTravel)),
+                             "Distance", DoubleValue (WALK_STEP),
                              "Speed", StringValue (speed));
   mobility.Install (c);
+  MobilityHelper::AssignStreams (c, MOBILITY_STREAM);
+}
+
+/*
+* A snapshot is the social tie state of every node at one moment: a
+* SnapshotFileHeader followed by what MyReceiver::SaveState wrote for each
+* node in turn, in host byte order. A run that loads one sends no hellos
+* before that moment and picks the state up from the file instead, so sweeps
+* over forwarding parameters skip the identical warm up. The nodes are only
+* where the snapshot expects them if the run moves them the same way, i.e.
+* with the same RngRun or mobility trace. The decode counts, metrics and
+* beacon timers are not part of a snapshot, so one can only be taken before
+* the source sends its first message.
+*/
+static const char SNAPSHOT_MAGIC[4] = { 'S', 'A', 'S', 'N' };
+static const uint16_t SNAPSHOT_VERSION = 1;
+static const double FIRST_MESSAGE = 0.321; //seconds, when the source sends its first message
+
+struct SnapshotFileHeader
+{
+  char magic[4];
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t nodeCount;
+  uint32_t reserved2;
+  int64_t time; //nanoseconds
+  uint64_t rngRun;
+  uint64_t size; //bytes of node state that follow
+};
+
+static void SaveSnapshot (SimulationContext *ctx, NodeRegistry *registry)
+{
+  SnapshotBuffer buffer;
+  for (uint32_t n = 0; n < registry -> GetSize(); n++)
+    registry -> Get(n) -> SaveState(buffer);
+  SnapshotFileHeader header;
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, SNAPSHOT_MAGIC, sizeof (header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.nodeCount = registry -> GetSize();
+  header.time = Now().GetNanoSeconds();
+  header.rngRun = ctx -> rngRun;
+  header.size = buffer.GetData().size();
+  FILE *file = fopen (ctx -> saveSnapshot.c_str(), "wb");
+  bool ok = file != NULL && fwrite (&header, sizeof (header), 1, file) == 1
+            && (header.size == 0 || fwrite (&buffer.GetData()[0], header.size, 1, file) == 1);
+  if (file != NULL && fclose (file) != 0)
+    ok = false;
+  if (!ok)
+    std::cerr << "cannot write " << ctx -> saveSnapshot << std::endl;
+}
+
+//read and check a snapshot file before the run, so a bad file fails early
+static bool ReadSnapshot (SimulationContext &ctx, SnapshotFileHeader &header, SnapshotBuffer &buffer)
+{
+  FILE *file = fopen (ctx.loadSnapshot.c_str(), "rb");
+  if (file == NULL)
+    {
+      std::cerr << "cannot read " << ctx.loadSnapshot << std::endl;
+      return false;
+    }
+  bool ok = fread (&header, sizeof (header), 1, file) == 1
+            && memcmp (header.magic, SNAPSHOT_MAGIC, sizeof (header.magic)) == 0
+            && header.version == SNAPSHOT_VERSION && header.nodeCount == (uint32_t) ctx.nodeSize;
+  if (ok)
+    {
+      buffer.GetData().resize(header.size);
+      ok = header.size == 0 || fread (&buffer.GetData()[0], header.size, 1, file) == 1;
+    }
+  fclose (file);
+  if (!ok)
+    {
+      std::cerr << ctx.loadSnapshot << " is not a snapshot of " << ctx.nodeSize << " nodes" << std::endl;
+      return false;
+    }
+  if (header.time > Seconds (FIRST_MESSAGE).GetNanoSeconds())
+    {
+      std::cerr << ctx.loadSnapshot << " was taken after the first message at " << FIRST_MESSAGE << " s" << std::endl;
+      return false;
+    }
+  if (ctx.readMobility.empty() && header.rngRun != ctx.rngRun)
+    std::cerr << "warning: " << ctx.loadSnapshot << " was taken with RngRun " << header.rngRun
+              << ", the nodes move differently in this run" << std::endl;
+  return true;
+}
+
+static void LoadSnapshot (SimulationContext *ctx, NodeRegistry *registry, SnapshotBuffer *buffer)
+{
+  for (uint32_t n = 0; n < registry -> GetSize(); n++)
+    if (!registry -> Get(n) -> LoadState(*buffer))
+      NS_FATAL_ERROR (ctx -> loadSnapshot << " holds a corrupt node state");
+}
+
+/*
+* Walk parameters, start positions and random streams of a random walk that
+* is already installed, for the next scenario of a batch. Setting a position
+* restarts the walk from there.
+*/
+static void ResetRandomWalk (SimulationContext &ctx, NodeContainer &c)
+{
+  Ptr<RandomDiscPositionAllocator> positions = StartPositions (ctx);
+  char speed[45];
+  sprintf(speed, "ns3::ConstantRandomVariable[Constant=%d]",ctx.nodeSpeed);
+  for (uint32_t n = 0; n < c.GetN (); n++)
+    {
+      Ptr<MobilityModel> mobility = c.Get (n) -> GetObject<MobilityModel> ();
+      mobility -> SetAttribute ("Bounds", RectangleValue (Rectangle (0-ctx.nodeTravel, ctx.nodeTravel, 0-ctx.nodeTravel, ctx.nodeTravel)));
+      mobility -> SetAttribute ("Speed", StringValue (speed));
+    }
+  MobilityHelper::AssignStreams (c, MOBILITY_STREAM);
+  for (uint32_t n = 0; n < c.GetN (); n++)
+    c.Get (n) -> GetObject<MobilityModel> () -> SetPosition (positions -> GetNext ());
+}
+
+/*****
+*
+* ScenarioInstance is the network a run is played on: the nodes with their
+* devices, internet stack, mobility and one MyReceiver each. Build sets it up
+* from ctx and Play runs one scenario on it from the current simulation time.
+* Reset gets it ready for another scenario without building it again: it
+* stops the protocol events, lets the frames still in flight drain, puts the
+* new parameters in ctx and resets the MyReceiver state, the node positions
+* and the random streams. The topology itself (node count, link layer and
+* mobility trace) stays what Build made.
+*
+*****/
+static const double BATCH_DRAIN = 0.5; //seconds of frames in flight dropped between scenarios
+
+class ScenarioInstance
+{
+public:
+  ScenarioInstance (SimulationContext &ctx);
+  ~ScenarioInstance ();
+  bool Build ();
+  bool Play ();
+  void Reset (const SimulationContext &next);
+private:
+  SimulationContext &ctx;
+  TraceReader mobilityTrace;
+  TraceMobilityPlayer *player;
+  TraceWriter mobilityCapture;
+  NetDeviceContainer devices;
+  NodeRegistry *registry;
+  AnimationInterface *anim;
+};
+
+ScenarioInstance::ScenarioInstance (SimulationContext &ctx)
+  : ctx(ctx)
+{
+  this -> player = NULL;
+  this -> registry = NULL;
+  this -> anim = NULL;
+}
+
+//after Simulator::Destroy
+ScenarioInstance::~ScenarioInstance ()
+{
+  delete anim;
+  delete player;
+  mobilityCapture.Close ();
+  if (registry != NULL)
+    for (uint32_t n = 0; n < registry -> GetSize(); n++)
+      delete registry -> Get(n);
+  delete registry;
+}
+
+bool
+ScenarioInstance::Build ()
+{
+  if (ctx.sourceNode < 0 || ctx.sourceNode >= ctx.nodeSize)
+    {
+      std::cerr << "sourceNode " << ctx.sourceNode << " is not one of the " << ctx.nodeSize << " nodes" << std::endl;
+      return false;
+    }
+  if (ctx.rngRun != 0)
+    RngSeedManager::SetRun (ctx.rngRun);
+  ctx.rngRun = RngSeedManager::GetRun ();
+
+  //initialize maliciousVector, now that the node count is known
+  ctx.InitMalicious();
+
+  NodeContainer &c = ctx.nodes;
+  c.Create (ctx.nodeSize);
+  INSTR_NODES(ctx.nodeSize);
+
+  //a trace node only changes course at its waypoints, so the grid rebuckets
+  //every node as often as the random walk would change its course
+  Time rebucket = Seconds (0);
+  if (!ctx.readMobility.empty())
+    {
+      if (!mobilityTrace.Open (ctx.readMobility) || mobilityTrace.GetKind () != TraceWriter::WAYPOINTS
+          || mobilityTrace.GetNodeCount () < (uint32_t) ctx.nodeSize)
+        {
+          std::cerr << ctx.readMobility << " is not a mobility trace of " << ctx.nodeSize << " nodes" << std::endl;
+          return false;
+        }
+      double maxSpeed = mobilityTrace.GetMaxSpeed ();
+      if (maxSpeed > 0)
+        rebucket = Seconds (WALK_STEP / maxSpeed);
+    }
+
+  if (ctx.channel == "grid")
+    {
+      Ptr<GridRangeChannel> channel = CreateObject<GridRangeChannel> (RADIO_RANGE, WALK_STEP);
+      channel -> SetRebucket (rebucket);
+      SimpleNetDeviceHelper simple;
+      devices = simple.Install (c, channel);
+    }
+  else if (ctx.channel == "disc")
+    devices = InstallDisc (ctx, c, rebucket);
+  else
+    devices = InstallWifi (c);
+
+  //nodes either walk at random or replay a recorded mobility trace
+  if (ctx.readMobility.empty())
+    InstallRandomWalk (ctx, c);
+  else
+    {
+      MobilityHelper mobility;
+      mobility.SetMobilityModel ("ns3::ConstantVelocityMobilityModel");
+      mobility.Install (c);
+      player = new TraceMobilityPlayer (mobilityTrace, c);
+      player -> Start ();
+    }
+  if (!ctx.writeMobility.empty())
+    {
+      if (!mobilityCapture.Open (ctx.writeMobility, TraceWriter::WAYPOINTS, ctx.nodeSize))
+        {
+          std::cerr << "cannot write " << ctx.writeMobility << std::endl;
+          return false;
+        }
+      mobilityCapture.Capture (c);
+    }
 
   InternetStackHelper internet;
   internet.Install (c);
@@ -872,56 +1944,674 @@ int main (int argc, char *argv[])
   TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
 
   //routing 
-  std::vector<MyReceiver* > myReceiverSink (nodesize_global);
-  for (uint32_t n = 0; n < (uint32_t) nodesize_global; n++) {
-      MyReceiver *receiver = new MyReceiver (c.Get(n), tid);
+  registry = new NodeRegistry (ctx.nodeSize);
+  for (uint32_t n = 0; n < (uint32_t) ctx.nodeSize; n++) {
+      MyReceiver *receiver = new MyReceiver (&ctx, c.Get(n), tid);
       receiver -> Receive (MakeCallback (&MyReceiver::ReceivePacket, receiver));
-      Simulator::Schedule (Seconds (0.1), &MyReceiver::SayHello, receiver, numPackets, Seconds (1.0));
-//      receiver -> SayHello(numPackets, interPacketInterval);
-      myReceiverSink.at(n) = receiver;
+      registry -> Add(receiver);
   }
 
-MyReceiver* source = myReceiverSink.at(sourceNode);
-Simulator::Schedule (Seconds (0.321), &MyReceiver::SayMessage, source, numPackets, Seconds (0.321), (uint16_t) 999, myReceiverSink);
-Simulator::Schedule (Seconds (0.321+movingDelay), &MyReceiver::SayKey, source, numPackets, Seconds (0.321+movingDelay), (uint16_t) 999, myReceiverSink);
+  //every worker of a sweep would write the same file, so only single runs animate
+  if (ctx.animation)
+    anim = new AnimationInterface ("simple-adhoc.xml");
+  return true;
+}
+
+//run one scenario for simulationTime from now and print its results
+bool
+ScenarioInstance::Play ()
+{
+  //arguments for packets
+  uint32_t numPackets = 10;
+
+  // Convert to time object
+  Time interPacketInterval = Seconds (ctx.movingDelay);
+
+  Time start = Simulator::Now ();
+  ctx.metrics.SetNodeCount (ctx.nodeSize);
+  BeaconScheduler beacons (registry, Seconds (1.0), Seconds (ctx.beaconMax), MilliSeconds (ctx.beaconJitter), ctx.beaconBudget);
+  EncounterSampler sampler (registry, ctx.nodes, RADIO_RANGE, Seconds (1.0));
+  //a loaded snapshot stands in for the encounters before it; it comes first among the events at its time
+  Time encountersStart = Seconds (0.1);
+  SnapshotFileHeader snapshotHeader;
+  SnapshotBuffer snapshot;
+  if (!ctx.loadSnapshot.empty())
+    {
+      if (!ReadSnapshot (ctx, snapshotHeader, snapshot))
+        return false;
+      encountersStart = std::max (encountersStart, NanoSeconds (snapshotHeader.time));
+      Simulator::Schedule (NanoSeconds (snapshotHeader.time), &LoadSnapshot, &ctx, registry, &snapshot);
+    }
+  else if (!ctx.saveSnapshot.empty())
+    Simulator::Schedule (Seconds (ctx.snapshotTime), &SaveSnapshot, &ctx, registry);
+  if (ctx.encounters == "analytic")
+    sampler.Start (encountersStart);
+  else
+    beacons.Start (encountersStart);
+
+MyReceiver* source = registry -> Get(ctx.sourceNode);
+source -> StartSource (numPackets, Seconds (FIRST_MESSAGE), Seconds (ctx.movingDelay));
 
 // Simulator::ScheduleWithContext (source->GetNode ()->GetId (),
  //                                 Seconds (1.0), &MyReceiver::SayMessage, 
    //                               source, numPackets, Seconds (2.0));
 
-  Simulator::Stop (Seconds (55.0));
-  AnimationInterface anim ("simple-adhoc.xml");
- /* for (int j = 0; j < messageCount; j++) {
+  Simulator::Stop (Seconds (ctx.simulationTime));
+ /* for (int j = 0; j < (int)messageSendTime.size(); j++) {
         //NS_LOG_UNCOND("message decode q: "<<g_decodeq.at(j));
 }*/
   
   Simulator::Run ();
-  Simulator::Destroy ();
+  //nothing of this scenario may fire in the next one
+  beacons.Stop ();
+  sampler.Stop ();
+  for (uint32_t n = 0; n < registry -> GetSize(); n++)
+    registry -> Get(n) -> Stop();
 //calculate total decoded, total malicious decoded, average delay time
-  double totalDecoded = 0.0;
-  for(int i = 0; i < (int)m_decodeQ.size(); i++) {
-    totalDecoded++;
+//decoded counts each key once, decodedByNodeType once by a good and once by a malicious node
+  double totalDecoded = ctx.decodes.GetMaliciousCount() + ctx.decodes.GetGoodCount();
+  NS_LOG_UNCOND ("Total Number of Messages Sent: "<<ctx.gTotalSent);
+  NS_LOG_UNCOND ("Total Number of Messages Decoded: "<<ctx.decodes.GetTotalCount());
+  NS_LOG_UNCOND ("Total Number of Messages Decoded by Good plus by Malicious: "<<totalDecoded);
+  NS_LOG_UNCOND ("Total Number of Messages Decoded by Malicious: "<<ctx.decodes.GetMaliciousCount());
+
+//message delay from first send to first decode
+  LatencyHistogram &latency = ctx.metrics.GetLatency();
+  ctx.avgDelay = latency.GetMean() / 1000.0;
+  ctx.p50Delay = latency.GetPercentile(50) / 1000.0;
+  ctx.p99Delay = latency.GetPercentile(99) / 1000.0;
+  ctx.maxDelay = latency.GetMax() / 1000.0;
+  NS_LOG_UNCOND ("Average Message Delay in milliseconds: "<<ctx.avgDelay);
+  NS_LOG_UNCOND ("Message Delay p50/p99/max in milliseconds: " << ctx.p50Delay << " / " << ctx.p99Delay << " / " << ctx.maxDelay);
+
+//calculate anonymity total
+  ctx.anonymity = ctx.rawTotalSent > 0 ? ctx.anonymityTotal/ctx.rawTotalSent : 0;
+NS_LOG_UNCOND ("Probability of randomly guessing the source on average: " << ctx.anonymity);
+
+//hello beacon overhead
+  ctx.beaconsSent = beacons.GetBeaconsSent();
+  NS_LOG_UNCOND ("Total Number of Hello Beacons Sent: " << ctx.beaconsSent);
+  NS_LOG_UNCOND ("Hello Beacons per Node per Second: " << ctx.beaconsSent/(double)ctx.nodeSize/ctx.simulationTime);
+  if (ctx.encounters == "analytic")
+    NS_LOG_UNCOND ("Encounters Sampled from Positions: " << sampler.GetEncounters());
+
+  if (!ctx.metricsFile.empty() &&
+      !ctx.metrics.Write(ctx.metricsFile, start, Simulator::Now(), Seconds (ctx.metricsStep)))
+    std::cerr << "cannot write " << ctx.metricsFile << std::endl;
+  return true;
+}
+
+void
+ScenarioInstance::Reset (const SimulationContext &next)
+{
+  //the receivers are stopped, so whatever still arrives is dropped
+  Simulator::Stop (Seconds (BATCH_DRAIN));
+  Simulator::Run ();
+
+  NodeContainer nodes = ctx.nodes;
+  ctx = next;
+  ctx.nodes = nodes;
+  RngSeedManager::SetRun (ctx.rngRun);
+  ctx.InitMalicious();
+  if (player != NULL)
+    player -> Restart ();
+  else
+    ResetRandomWalk (ctx, ctx.nodes);
+  //the link loss of a disc channel and the 802.11b backoffs draw from the new run too
+  if (ctx.channel == "wifi")
+    {
+      WifiHelper wifi;
+      wifi.AssignStreams (devices, WIFI_STREAM);
+    }
+  for (uint32_t n = 0; n < ctx.nodes.GetN (); n++)
+    {
+      Ptr<SimpleNetDevice> device = DynamicCast<SimpleNetDevice> (ctx.nodes.Get (n) -> GetDevice (0));
+      PointerValue loss;
+      if (device == 0)
+        continue;
+      device -> GetAttribute ("ReceiveErrorModel", loss);
+      Ptr<RateErrorModel> model = loss.Get<RateErrorModel> ();
+      if (model != 0)
+        model -> AssignStreams (LOSS_STREAM + n);
+    }
+  registry -> GetTracker().Reset();
+  for (uint32_t n = 0; n < registry -> GetSize(); n++)
+    registry -> Get(n) -> Reset();
+}
+
+//write the counters of this process, if they were compiled in
+static void DumpInstrumentation (const std::string &fileName)
+{
+#ifdef SOCIAL_TIE_INSTRUMENT
+  if (fileName.empty())
+    return;
+  std::ofstream out (fileName.c_str());
+  Instrumentation::Get().Dump(out);
+  if (!out)
+    std::cerr << "cannot write " << fileName << std::endl;
+#endif
+}
+
+/*
+* RunSimulation builds the network described by ctx, runs it and prints the
+* results. All per-run state is reached through ctx.
+*/
+int RunSimulation (SimulationContext &ctx)
+{
+  ScenarioInstance instance (ctx);
+  bool ok = instance.Build () && instance.Play ();
+  Simulator::Destroy ();
+  DumpInstrumentation (ctx.instrumentation);
+  return ok ? 0 : 1;
+}
+
+//"metrics.json" becomes "metrics-3.json" for run 3 of a sweep or batch
+static std::string IndexedName (const std::string &fileName, uint32_t index)
+{
+  std::ostringstream name;
+  std::string::size_type dot = fileName.rfind('.');
+  if (dot == std::string::npos || fileName.find('/', dot) != std::string::npos)
+    dot = fileName.size();
+  name << fileName.substr(0, dot) << '-' << index << fileName.substr(dot);
+  return name.str();
+}
+
+//split a list on sep, "10,20,50" gives three entries; empty entries are dropped unless keepEmpty
+static std::vector<std::string> SplitList (const std::string &list, char sep, bool keepEmpty = false)
+{
+  std::vector<std::string> items;
+  std::string::size_type begin = 0;
+  while (begin <= list.size()) {
+    std::string::size_type end = list.find(sep, begin);
+    if (end == std::string::npos)
+      end = list.size();
+    if (end > begin || keepEmpty)
+      items.push_back(list.substr(begin, end - begin));
+    begin = end + 1;
   }
-  for(int i = 0; i < (int)g_decodeQ.size(); i++) {
-    totalDecoded++;
+  return items;
+}
+
+/*
+* A sweep is given as a grid, a points file or both. The grid
+* "nodeSize=20,50;threshold=0.5,1" runs every combination of the values
+* listed for each parameter. A points file holds one point per line as
+* name=value pairs separated by spaces, lines starting with # are skipped.
+* With both, every line of the file is expanded by the grid. Parameters a
+* spec does not name keep the value of the single run options.
+*/
+static bool ReadPoints (const std::string &fileName, const SimulationContext &base, std::vector<SimulationContext> &points)
+{
+  std::ifstream in (fileName.c_str());
+  if (!in) {
+    std::cerr << "cannot open points file " << fileName << std::endl;
+    return false;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    SimulationContext point = base;
+    std::istringstream fields (line);
+    std::string field;
+    while (fields >> field) {
+      std::string::size_type eq = field.find('=');
+      if (eq == std::string::npos || !point.Set(field.substr(0, eq), field.substr(eq + 1))) {
+        std::cerr << "bad parameter " << field << " in " << fileName << std::endl;
+        return false;
+      }
+    }
+    points.push_back(point);
   }
-  NS_LOG_UNCOND ("Total Number of Messages Sent: "<<gTotalSent);
-  NS_LOG_UNCOND ("Total Number of Messages Decoded: "<<totalDecoded);
-  NS_LOG_UNCOND ("Total Number of Messages Decoded by Malicious: "<<m_decodeQ.size());
+  return true;
+}
 
-//calculate average message delay time
-  uint64_t totalDiff = 0;
-  for (int i = 0; i < (int)messageReceivedTime.size(); i++) {
-    if (messageReceivedTime.at(i) > 0) {
-      totalDiff += messageReceivedTime.at(i) - messageSendTime.at(i);
+static bool ExpandGrid (const std::string &grid, std::vector<SimulationContext> &points)
+{
+  std::vector<std::string> axes = SplitList(grid, ';');
+  for (uint32_t a = 0; a < axes.size(); a++) {
+    std::string::size_type eq = axes[a].find('=');
+    std::vector<std::string> values;
+    if (eq != std::string::npos)
+      values = SplitList(axes[a].substr(eq + 1), ',');
+    if (values.empty()) {
+      std::cerr << "bad grid axis " << axes[a] << std::endl;
+      return false;
     }
+    std::string name = axes[a].substr(0, eq);
+    std::vector<SimulationContext> expanded;
+    for (uint32_t p = 0; p < points.size(); p++)
+      for (uint32_t v = 0; v < values.size(); v++) {
+        SimulationContext point = points[p];
+        if (!point.Set(name, values[v])) {
+          std::cerr << "bad sweep parameter " << name << "=" << values[v] << std::endl;
+          return false;
+        }
+        expanded.push_back(point);
+      }
+    points.swap(expanded);
   }
-  double avgDelayTime = totalDiff/(double)gTotalDecode.size();
-  NS_LOG_UNCOND ("Average Message Delay in milliseconds: "<<avgDelayTime);
+  return true;
+}
 
-//calculate anonymity total
-NS_LOG_UNCOND ("Probability of randomly guessing the source on average: " << anonymityTotal/rawTotalSent);
+/*
+* RunWorkers runs points first..last-1, one simulation per point. ns-3 keeps
+* the simulator, the config and the random streams in process-wide singletons
+* and is not thread safe, so every point runs in its own forked worker. At most
+* jobs workers run at a time and point n writes its log to <logPrefix>-n.log.
+* Point n uses RngRun firstRun + n, so no two points share random streams.
+* A worker sends its CSV row back through a pipe. The row is appended to
+* results as soon as the worker exits, so an interrupted run keeps every point
+* it finished, and stored in rows[n]; failed points leave rows[n] empty.
+* Returns the number of failed points, or -1 if no worker could be started.
+*/
+struct Worker
+{
+  uint32_t point;
+  int fd; //read end of the pipe the worker writes its row to
+};
 
+static int RunWorkers (std::vector<SimulationContext> &points, uint32_t first, uint32_t last, int jobs,
+                       uint64_t firstRun, const std::string &logPrefix, std::ostream &results,
+                       std::vector<std::string> &rows)
+{
+  std::map<pid_t, Worker> running;
+  uint32_t next = first;
+  int failed = 0;
+  rows.resize(points.size());
+  while (next < last || !running.empty()) {
+    if (next < last && (int) running.size() < jobs) {
+      int fds[2];
+      if (pipe(fds) < 0) {
+        perror("pipe");
+        return -1;
+      }
+      std::cout.flush();
+      pid_t pid = fork();
+      if (pid < 0) {
+        perror("fork");
+        return -1;
+      }
+      if (pid == 0) {
+        close(fds[0]);
+        char logName[256];
+        snprintf(logName, sizeof(logName), "%s-%u.log", logPrefix.c_str(), next);
+        int fd = open(logName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+          dup2(fd, STDOUT_FILENO);
+          dup2(fd, STDERR_FILENO);
+          close(fd);
+        }
+        SimulationContext &ctx = points[next];
+        ctx.rngRun = firstRun + next;
+        if (!ctx.instrumentation.empty()) {
+          snprintf(logName, sizeof(logName), "%s-%u.json", logPrefix.c_str(), next);
+          ctx.instrumentation = logName;
+        }
+        if (!ctx.metricsFile.empty())
+          ctx.metricsFile = IndexedName(ctx.metricsFile, next);
+        int status = RunSimulation(ctx);
+        std::string row = ctx.CsvRow(next) + "\n";
+        if (status == 0 && write(fds[1], row.data(), row.size()) != (ssize_t) row.size())
+          status = 1;
+        std::cout.flush();
+        std::cerr.flush();
+        _exit(status);
+      }
+      close(fds[1]);
+      Worker worker;
+      worker.point = next++;
+      worker.fd = fds[0];
+      running[pid] = worker;
+      continue;
+    }
+    int status = 0;
+    pid_t pid = waitpid(-1, &status, 0);
+    if (pid < 0) {
+      perror("waitpid");
+      return -1;
+    }
+    std::map<pid_t, Worker>::iterator it = running.find(pid);
+    if (it == running.end())
+      continue;
+    std::string row;
+    char buffer[512];
+    ssize_t got;
+    while ((got = read(it->second.fd, buffer, sizeof(buffer))) > 0)
+      row.append(buffer, got);
+    close(it->second.fd);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || row.empty()) {
+      std::cout << "point " << it->second.point << " failed, see " << logPrefix << "-" << it->second.point << ".log" << std::endl;
+      failed++;
+    }
+    else {
+      results << row;
+      results.flush();
+      rows[it->second.point] = row;
+    }
+    running.erase(it);
+  }
+  return failed;
+}
 
+static int RunSweep (std::vector<SimulationContext> &points, int jobs, uint64_t firstRun, const std::string &resultsName)
+{
+  std::ofstream results (resultsName.c_str());
+  if (!results) {
+    std::cerr << "cannot write " << resultsName << std::endl;
+    return 1;
+  }
+  results << SimulationContext::CsvHeader() << std::endl;
+  std::vector<std::string> rows;
+  int failed = RunWorkers(points, 0, points.size(), jobs, firstRun, "sweep", results, rows);
+  if (failed < 0)
+    return 1;
+  std::cout << points.size() - failed << " of " << points.size() << " parameter points written to " << resultsName << std::endl;
+  return failed == 0 ? 0 : 1;
+}
+
+/*
+* A batch plays every scenario of a points file, one after the other, on a
+* single ScenarioInstance in this process. Scenario n runs with RngRun
+* firstRun + n like a sweep point, but the topology is only built once, so
+* all scenarios must share it. Snapshots start from simulation time zero and
+* are left to single runs.
+*/
+static int RunBatch (std::vector<SimulationContext> &scenarios, uint64_t firstRun, const std::string &resultsName)
+{
+  for (uint32_t n = 0; n < scenarios.size(); n++) {
+    SimulationContext &scenario = scenarios[n];
+    if (scenario.nodeSize != scenarios[0].nodeSize || scenario.channel != scenarios[0].channel
+        || scenario.linkLatency != scenarios[0].linkLatency || scenario.linkRate != scenarios[0].linkRate
+        || scenario.linkLoss != scenarios[0].linkLoss || scenario.readMobility != scenarios[0].readMobility) {
+      std::cerr << "scenario " << n << " changes the topology (nodeSize, channel, link or readMobility) of the batch" << std::endl;
+      return 1;
+    }
+    if (!scenario.loadSnapshot.empty()) {
+      std::cerr << "a batch cannot start from a snapshot" << std::endl;
+      return 1;
+    }
+    if (scenario.sourceNode < 0 || scenario.sourceNode >= scenario.nodeSize) {
+      std::cerr << "scenario " << n << " has sourceNode " << scenario.sourceNode << ", not one of the " << scenario.nodeSize << " nodes" << std::endl;
+      return 1;
+    }
+    scenario.rngRun = firstRun + n;
+    if (!scenario.metricsFile.empty())
+      scenario.metricsFile = IndexedName(scenario.metricsFile, n);
+  }
+  std::ofstream results (resultsName.c_str());
+  if (!results) {
+    std::cerr << "cannot write " << resultsName << std::endl;
+    return 1;
+  }
+  results << SimulationContext::CsvHeader() << std::endl;
+  if (scenarios.empty())
+    return 0;
+
+  SimulationContext ctx = scenarios[0];
+  ScenarioInstance instance (ctx);
+  bool ok = instance.Build ();
+  for (uint32_t n = 0; ok && n < scenarios.size(); n++) {
+    if (n > 0)
+      instance.Reset (scenarios[n]);
+    ok = instance.Play ();
+    if (ok)
+      results << ctx.CsvRow(n) << std::endl;
+  }
+  Simulator::Destroy ();
+  DumpInstrumentation (ctx.instrumentation);
+  if (!ok)
+    return 1;
+  std::cout << scenarios.size() << " scenarios written to " << resultsName << std::endl;
+  return 0;
+}
+
+//the value of a named column in a row written by SimulationContext::CsvRow
+static double CsvColumn (const std::string &row, const std::string &name)
+{
+  //readMobility and loadSnapshot are usually empty, so empty columns must keep their place
+  std::vector<std::string> columns = SplitList(SimulationContext::CsvHeader(), ',', true);
+  std::vector<std::string> values = SplitList(row, ',', true);
+  for (uint32_t i = 0; i < columns.size() && i < values.size(); i++)
+    if (columns[i] == name)
+      return atof(values[i].c_str());
   return 0;
 }
+
+/*
+* ReplicationStat keeps the running mean and variance of one metric over
+* the replications so far (Welford's update) and the Student t confidence
+* interval around the mean.
+*/
+class ReplicationStat
+{
+public:
+  ReplicationStat();
+  void Add(double x);
+  uint32_t GetCount();
+  double GetMean();
+  double GetHalfWidth(double confidence);
+private:
+  uint32_t count;
+  double mean;
+  double m2; //sum of squared distances from the mean
+};
+
+ReplicationStat::ReplicationStat()
+{
+  this -> count = 0;
+  this -> mean = 0;
+  this -> m2 = 0;
+}
+
+void
+ReplicationStat::Add(double x)
+{
+  count++;
+  double delta = x - mean;
+  mean += delta / count;
+  m2 += delta * (x - mean);
+}
+
+uint32_t
+ReplicationStat::GetCount()
+{
+  return this -> count;
+}
+
+double
+ReplicationStat::GetMean()
+{
+  return this -> mean;
+}
+
+//upper (1 - confidence) / 2 quantile of Student's t with dof degrees of freedom.
+//The normal quantile (Abramowitz and Stegun 26.2.23) is corrected for dof with
+//the Cornish-Fisher expansion (26.7.5), which is within 1% from 3 dof on.
+//Below that the expansion is far too small, so 1 and 2 dof use their closed forms.
+static double StudentQuantile (double confidence, uint32_t dof)
+{
+  double p = (1 - confidence) / 2;
+  if (dof == 1)
+    return tan(M_PI * (0.5 - p));
+  if (dof == 2)
+    return (1 - 2 * p) / sqrt(2 * p * (1 - p));
+  double t = sqrt(-2 * log(p));
+  double z = t - (2.515517 + 0.802853 * t + 0.010328 * t * t)
+                 / (1 + 1.432788 * t + 0.189269 * t * t + 0.001308 * t * t * t);
+  double n = dof;
+  double z3 = z * z * z;
+  double z5 = z3 * z * z;
+  double z7 = z5 * z * z;
+  double z9 = z7 * z * z;
+  return z + (z3 + z) / (4 * n)
+           + (5 * z5 + 16 * z3 + 3 * z) / (96 * n * n)
+           + (3 * z7 + 19 * z5 + 17 * z3 - 15 * z) / (384 * n * n * n)
+           + (79 * z9 + 776 * z7 + 1482 * z5 - 1920 * z3 - 945 * z) / (92160 * n * n * n * n);
+}
+
+double
+ReplicationStat::GetHalfWidth(double confidence)
+{
+  if (count < 2)
+    return HUGE_VAL;
+  return StudentQuantile(confidence, count - 1) * sqrt(m2 / (count - 1) / count);
+}
+
+/*
+* RunReplications repeats the configuration with a new RngRun each time and
+* stops once the confidence interval of every tracked metric is narrower than
+* target, relative to its mean, or after maxReplications. Replications run in
+* batches of jobs workers, so a batch may overshoot the stopping point by up
+* to jobs - 1 replications. Every replication is written to resultsName.
+*/
+static int RunReplications (const SimulationContext &config, int jobs, uint64_t firstRun, const std::string &resultsName,
+                            uint32_t minReplications, uint32_t maxReplications, double target, double confidence)
+{
+  const char *metrics[] = { "deliveryRatio", "avgDelayMs", "anonymity" };
+  const uint32_t metricCount = sizeof(metrics) / sizeof(metrics[0]);
+  std::ofstream results (resultsName.c_str());
+  if (!results) {
+    std::cerr << "cannot write " << resultsName << std::endl;
+    return 1;
+  }
+  results << SimulationContext::CsvHeader() << std::endl;
+
+  std::vector<SimulationContext> points (maxReplications, config);
+  std::vector<std::string> rows;
+  std::vector<ReplicationStat> stats (metricCount);
+  uint32_t done = 0;
+  bool converged = false;
+  while (done < maxReplications && !converged) {
+    uint32_t batch = std::max((uint32_t) jobs, minReplications > done ? minReplications - done : 0);
+    batch = std::min(batch, maxReplications - done);
+    if (RunWorkers(points, done, done + batch, jobs, firstRun, "replication", results, rows) < 0)
+      return 1;
+    for (uint32_t r = done; r < done + batch; r++)
+      if (!rows[r].empty())
+        for (uint32_t m = 0; m < metricCount; m++)
+          stats[m].Add(CsvColumn(rows[r], metrics[m]));
+    done += batch;
+
+    converged = stats[0].GetCount() >= minReplications;
+    for (uint32_t m = 0; m < metricCount; m++) {
+      double halfWidth = stats[m].GetHalfWidth(confidence);
+      std::cout << metrics[m] << " after " << stats[m].GetCount() << " replications: "
+                << stats[m].GetMean() << " +- " << halfWidth << std::endl;
+      if (halfWidth > target * fabs(stats[m].GetMean()))
+        converged = false;
+    }
+  }
+  std::cout << (converged ? "converged" : "did not converge") << " after " << stats[0].GetCount()
+            << " replications, " << confidence * 100 << "% intervals written above, runs in " << resultsName << std::endl;
+  return stats[0].GetCount() > 0 ? 0 : 1;
+}
+
+int main (int argc, char *argv[])
+{
+  std::cout<< "input arguments in the following sequence, number of nodes, node density, nodes speed, malicious node percentage, message count, broadcast threshold, source moving delay" << std::endl;
+  //input arguments in the following sequence, number of nodes, node density, nodes speed, malicious node percentage, message count, broadcast threshold, source moving delay
+  SimulationContext config;
+  std::string grid = "";
+  std::string pointsFile = "";
+  std::string batchFile = "";
+  std::string resultsName = "sweep-results.csv";
+  int jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  uint32_t replications = 0;
+  uint32_t minReplications = 5;
+  double ciTarget = 0.05;
+  double confidence = 0.95;
+  CommandLine cmd;
+  cmd.AddValue ("nodeSize", "number of nodes (default 50)", config.nodeSize);
+  cmd.AddValue ("nodeSparseness", "density of the network (default 10)", config.nodeSparseness);
+  cmd.AddValue ("nodeTravel", "how far a node will travel (default 300)", config.nodeTravel);
+  cmd.AddValue ("nodeSpeed", "speed of each node (default 100.0)", config.nodeSpeed);
+  cmd.AddValue ("maliRatio", "percentage of malicious nodes (default 0.5)", config.maliRatio);
+  cmd.AddValue ("beaconJitter", "milliseconds a hello beacon may move from its period (default 10)", config.beaconJitter);
+  cmd.AddValue ("beaconBudget", "hello beacons each node may send, 0 for no limit (default 0)", config.beaconBudget);
+  cmd.AddValue ("adaptiveBeacon", "adapt each hello interval to how fast neighbors change (default false)", config.adaptiveBeacon);
+  cmd.AddValue ("beaconMin", "shortest adaptive hello interval in seconds (default 0.25)", config.beaconMin);
+  cmd.AddValue ("beaconMax", "longest adaptive hello interval in seconds (default 5.0)", config.beaconMax);
+  cmd.AddValue ("dupWindow", "milliseconds a node will not forward the same packet again (default 1000)", config.dupWindow);
+  cmd.AddValue ("matchWindow", "milliseconds a message and its key can be apart and still match (default 1500)", config.matchWindow);
+  cmd.AddValue ("threshold", "threshold for every node to broadcast (default 1.0)", config.threshold);
+  cmd.AddValue ("delay", "the time period between sending message and key (default 3)", config.movingDelay);
+  cmd.AddValue ("validPeriod", "seconds an encounter is kept in the encounter list (default 20)", config.validPeriod);
+  cmd.AddValue ("sourceNode", "the node chosen to be the source (default 2)", config.sourceNode);
+  cmd.AddValue ("simulationTime", "seconds to simulate (default 55)", config.simulationTime);
+  cmd.AddValue ("encounters", "packet to build encounters from hello beacons, analytic to sample them from the node positions once a second; the beacon options are then unused (default packet)", config.encounters);
+  cmd.AddValue ("channel", "wifi for the 802.11b stack; grid for an ideal range channel without MAC contention or PHY loss, so not a faster wifi and not comparable with it; disc for grid with a set latency, rate and loss (default wifi)", config.channel);
+  cmd.AddValue ("linkLatency", "milliseconds a disc channel frame takes to arrive (default 1)", config.linkLatency);
+  cmd.AddValue ("linkRate", "rate a disc channel device sends at (default 1Mbps)", config.linkRate);
+  cmd.AddValue ("linkLoss", "probability a disc channel frame is lost (default 0)", config.linkLoss);
+  cmd.AddValue ("readMobility", "replay this binary mobility trace instead of the random walk", config.readMobility);
+  cmd.AddValue ("writeMobility", "record the mobility of a single run to this binary trace", config.writeMobility);
+  cmd.AddValue ("saveSnapshot", "save the social tie state of a single run to this file at snapshotTime", config.saveSnapshot);
+  cmd.AddValue ("snapshotTime", "seconds into the run saveSnapshot is taken, no later than the first message and ahead of it (default 0.321, the first message)", config.snapshotTime);
+  cmd.AddValue ("loadSnapshot", "start from the social tie state in this file instead of sending hellos before it was taken", config.loadSnapshot);
+  cmd.AddValue ("instrumentation", "JSON file the routing counters and timers go to, if built with -DSOCIAL_TIE_INSTRUMENT; sweep workers use <sweep|replication>-n.json (default instrumentation.json)", config.instrumentation);
+  cmd.AddValue ("metrics", "file the delay histogram, forwards per node and delivery over time are written to, CSV if it ends in .csv, empty for none; sweeps and batches number it per run (default metrics.json)", config.metricsFile);
+  cmd.AddValue ("metricsStep", "seconds between the points of the delivery ratio over time (default 1)", config.metricsStep);
+  cmd.AddValue ("animation", "write simple-adhoc.xml for NetAnim on single runs (default true)", config.animation);
+  cmd.AddValue ("grid", "sweep every combination, e.g. \"nodeSize=20,50;threshold=0.5,1\"", grid);
+  cmd.AddValue ("points", "sweep the points in this file, one line of name=value pairs per point", pointsFile);
+  cmd.AddValue ("batch", "play the scenarios in this file, one line of name=value pairs each, on one topology in this process", batchFile);
+  cmd.AddValue ("results", "CSV file a sweep, batch or replication run writes one row per run to (default sweep-results.csv)", resultsName);
+  cmd.AddValue ("jobs", "worker processes a sweep runs at once (default: number of cores)", jobs);
+  cmd.AddValue ("replications", "repeat the run up to this many times with new random streams, 0 for one run (default 0)", replications);
+  cmd.AddValue ("minReplications", "replications before the stopping rule is checked (default 5)", minReplications);
+  cmd.AddValue ("ciTarget", "stop once every confidence interval half-width is below this fraction of its mean (default 0.05)", ciTarget);
+  cmd.AddValue ("confidence", "confidence level of the intervals (default 0.95)", confidence);
+  cmd.Parse (argc, argv);
+
+  if (!SimulationContext::IsChannel (config.channel)) {
+    std::cerr << "unknown channel " << config.channel << ", use wifi, grid or disc" << std::endl;
+    return 1;
+  }
+  if (!config.saveSnapshot.empty() && config.snapshotTime > FIRST_MESSAGE) {
+    std::cerr << "--snapshotTime must not be after the first message at " << FIRST_MESSAGE << " s" << std::endl;
+    return 1;
+  }
+  if (jobs < 1)
+    jobs = 1;
+  if (replications > 0) {
+    if (!grid.empty() || !pointsFile.empty()) {
+      std::cerr << "--replications repeats a single configuration and cannot be combined with a sweep" << std::endl;
+      return 1;
+    }
+    config.animation = false;
+    config.writeMobility = "";
+    config.saveSnapshot = "";
+    minReplications = std::max(minReplications, (uint32_t) 3);
+    return RunReplications (config, jobs, RngSeedManager::GetRun (), resultsName,
+                            std::min(minReplications, replications), replications, ciTarget, confidence);
+  }
+  if (!batchFile.empty()) {
+    if (!grid.empty() || !pointsFile.empty()) {
+      std::cerr << "--batch runs its own scenarios and cannot be combined with a sweep" << std::endl;
+      return 1;
+    }
+    config.animation = false;
+    config.writeMobility = "";
+    config.saveSnapshot = "";
+    std::vector<SimulationContext> scenarios;
+    if (!ReadPoints(batchFile, config, scenarios))
+      return 1;
+    return RunBatch (scenarios, RngSeedManager::GetRun (), resultsName);
+  }
+  if (grid.empty() && pointsFile.empty())
+    return RunSimulation (config);
+
+  config.animation = false;
+  config.writeMobility = "";
+  config.saveSnapshot = "";
+  std::vector<SimulationContext> points;
+  if (pointsFile.empty())
+    points.push_back(config);
+  else if (!ReadPoints(pointsFile, config, points))
+    return 1;
+  if (!ExpandGrid(grid, points))
+    return 1;
+  //the first point runs with --RngRun, the others count up from it
+  return RunSweep (points, jobs, RngSeedManager::GetRun (), resultsName);
+}
@@ -0,0 +1,688 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+
+//
+// Replays a contact trace through the social tie protocol of simple-adhoc.cc
+// without packets, sockets or a PHY. The encounter lists, scores, message/key
+// matching and duplicate suppression are the ones in SocialTie.h; only who is
+// in range of whom comes from the trace.
+//
+// A trace is a text file with one contact per line,
+//   <start seconds> <end seconds> <node a> <node b>
+// meaning a and b are in range of each other from start to end. Lines that
+// start with # are skipped. A binary contact trace (MobilityTrace.h) works
+// as well. A trace can be generated once from the same random walk
+// simple-adhoc.cc uses, or from a mobility trace it recorded; names ending
+// in .bin get the binary format:
+//
+// ./waf --run "social-tie-trace --generate=contacts.txt --nodeSize=50"
+// ./waf --run "social-tie-trace --generate=contacts.bin --mobility=walk.bin"
+//
+// and then replayed with any protocol parameters:
+//
+// ./waf --run "social-tie-trace --trace=contacts.txt --threshold=0.5"
+//
+// Like simple-adhoc.cc, every node hears the hellos of the nodes it is in
+// contact with once per beacon period, the source sends a message every
+// 0.321 s and a key every 0.321 s + delay to any node, and a node that gets
+// a half it cannot decode forwards it to the neighbors calculateMaxScore
+// picks. A broadcast reaches the nodes in contact with the sender after
+// hopDelay.
+//
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <queue>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SocialTie.h"
+#include "MobilityTrace.h"
+#include "Metrics.h"
+
+using namespace ns3;
+
+static const double RADIO_RANGE = 10.0; //meters, as in simple-adhoc.cc
+static const uint32_t ANY_NODE = 0xffffffff;
+
+struct Contact
+{
+  double start; //seconds
+  double end;
+  uint32_t a;
+  uint32_t b;
+};
+
+static bool ReadBinaryContacts (const std::string &fileName, std::vector<Contact> &contacts)
+{
+  TraceReader reader;
+  if (!reader.Open (fileName) || reader.GetKind () != TraceWriter::CONTACTS) {
+    std::cerr << fileName << " is not a contact trace" << std::endl;
+    return false;
+  }
+  const ContactRecord *records = reader.GetContacts ();
+  int64_t start = 0; //microseconds
+  contacts.reserve (reader.GetRecordCount ());
+  for (uint64_t i = 0; i < reader.GetRecordCount (); i++) {
+    start += records[i].dt;
+    Contact contact = { start / 1e6, (start + records[i].duration) / 1e6, records[i].a, records[i].b };
+    contacts.push_back (contact);
+  }
+  return true;
+}
+
+static bool ReadContacts (const std::string &fileName, std::vector<Contact> &contacts)
+{
+  if (TraceReader::IsTrace (fileName))
+    return ReadBinaryContacts (fileName, contacts);
+  std::ifstream in (fileName.c_str());
+  if (!in) {
+    std::cerr << "cannot open trace " << fileName << std::endl;
+    return false;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::istringstream fields (line);
+    Contact contact;
+    if (!(fields >> contact.start >> contact.end >> contact.a >> contact.b)) {
+      std::cerr << "bad contact \"" << line << "\" in " << fileName << std::endl;
+      return false;
+    }
+    contacts.push_back(contact);
+  }
+  return true;
+}
+
+/*
+* ContactSampler records the contacts of a random walk. Every step it
+* buckets the nodes into a grid of RADIO_RANGE cells and checks the pairs
+* in neighbouring cells; a contact opens the first step a pair is in range
+* and closes the first step it is not.
+*/
+class ContactSampler
+{
+public:
+  ContactSampler (NodeContainer nodes, Time step, std::vector<Contact> &contacts);
+  void Sample ();
+  void Finish ();
+private:
+  static uint64_t PairKey (uint32_t a, uint32_t b);
+  NodeContainer nodes;
+  Time step;
+  std::vector<Contact> &contacts;
+  std::map<uint64_t, double> open; //start of every open contact
+};
+
+ContactSampler::ContactSampler (NodeContainer nodes, Time step, std::vector<Contact> &contacts)
+  : contacts(contacts)
+{
+  this -> nodes = nodes;
+  this -> step = step;
+}
+
+uint64_t
+ContactSampler::PairKey (uint32_t a, uint32_t b)
+{
+  return ((uint64_t) a << 32) | b;
+}
+
+void
+ContactSampler::Sample ()
+{
+  double now = Simulator::Now ().GetSeconds ();
+  std::map<std::pair<int32_t, int32_t>, std::vector<uint32_t> > cells;
+  std::vector<Vector> positions (nodes.GetN ());
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+  {
+    positions[i] = nodes.Get (i) -> GetObject<MobilityModel> () -> GetPosition ();
+    cells[std::make_pair ((int32_t) floor (positions[i].x / RADIO_RANGE), (int32_t) floor (positions[i].y / RADIO_RANGE))].push_back (i);
+  }
+  std::set<uint64_t> inRange;
+  for (uint32_t a = 0; a < nodes.GetN (); a++)
+  {
+    int32_t x = (int32_t) floor (positions[a].x / RADIO_RANGE);
+    int32_t y = (int32_t) floor (positions[a].y / RADIO_RANGE);
+    for (int32_t dx = -1; dx <= 1; dx++)
+      for (int32_t dy = -1; dy <= 1; dy++)
+      {
+        std::map<std::pair<int32_t, int32_t>, std::vector<uint32_t> >::iterator cell = cells.find (std::make_pair (x + dx, y + dy));
+        if (cell == cells.end ())
+          continue;
+        for (uint32_t i = 0; i < cell -> second.size (); i++)
+        {
+          uint32_t b = cell -> second[i];
+          if (b > a && CalculateDistance (positions[a], positions[b]) <= RADIO_RANGE)
+            inRange.insert (PairKey (a, b));
+        }
+      }
+  }
+  //close the contacts that ended, then open the new ones
+  std::map<uint64_t, double>::iterator it = open.begin ();
+  while (it != open.end ())
+  {
+    if (inRange.count (it -> first) == 0)
+    {
+      Contact contact = { it -> second, now, (uint32_t) (it -> first >> 32), (uint32_t) it -> first };
+      contacts.push_back (contact);
+      open.erase (it++);
+    }
+    else
+      ++it;
+  }
+  for (std::set<uint64_t>::iterator pair = inRange.begin (); pair != inRange.end (); ++pair)
+    if (open.count (*pair) == 0)
+      open[*pair] = now;
+  Simulator::Schedule (step, &ContactSampler::Sample, this);
+}
+
+//contacts still open when the walk stops end with it
+void
+ContactSampler::Finish ()
+{
+  double now = Simulator::Now ().GetSeconds ();
+  for (std::map<uint64_t, double>::iterator it = open.begin (); it != open.end (); ++it)
+  {
+    Contact contact = { it -> second, now, (uint32_t) (it -> first >> 32), (uint32_t) it -> first };
+    contacts.push_back (contact);
+  }
+  open.clear ();
+}
+
+static bool ContactStartsBefore (const Contact &a, const Contact &b)
+{
+  return a.start < b.start;
+}
+
+static bool WriteContacts (const std::string &fileName, std::vector<Contact> &contacts, uint32_t nodeSize)
+{
+  if (fileName.size () > 4 && fileName.compare (fileName.size () - 4, 4, ".bin") == 0)
+  {
+    std::sort (contacts.begin (), contacts.end (), ContactStartsBefore);
+    TraceWriter writer;
+    if (!writer.Open (fileName, TraceWriter::CONTACTS, nodeSize))
+      return false;
+    for (uint32_t i = 0; i < contacts.size (); i++)
+      if (!writer.AddContact (contacts[i].a, contacts[i].b, Seconds (contacts[i].start), Seconds (contacts[i].end)))
+      {
+        std::cerr << "contact " << i << " of " << fileName << " ends before it starts" << std::endl;
+        writer.Close ();
+        return false;
+      }
+    return writer.Close ();
+  }
+  std::ofstream out (fileName.c_str ());
+  out << "# start end a b" << std::endl;
+  for (uint32_t i = 0; i < contacts.size (); i++)
+    out << contacts[i].start << " " << contacts[i].end << " " << contacts[i].a << " " << contacts[i].b << std::endl;
+  return out.good ();
+}
+
+//a recorded mobility trace, or the random walk of simple-adhoc.cc, sampled into contacts
+static bool GenerateContacts (int nodeSize, int nodeSparseness, int nodeTravel, int nodeSpeed, double duration,
+                              Time step, const std::string &mobilityName, std::vector<Contact> &contacts)
+{
+  NodeContainer c;
+  c.Create (nodeSize);
+  TraceReader mobilityTrace;
+  TraceMobilityPlayer *player = NULL;
+  if (!mobilityName.empty ())
+  {
+    if (!mobilityTrace.Open (mobilityName) || mobilityTrace.GetKind () != TraceWriter::WAYPOINTS
+        || mobilityTrace.GetNodeCount () < (uint32_t) nodeSize)
+    {
+      std::cerr << mobilityName << " is not a mobility trace of " << nodeSize << " nodes" << std::endl;
+      return false;
+    }
+    MobilityHelper mobility;
+    mobility.SetMobilityModel ("ns3::ConstantVelocityMobilityModel");
+    mobility.Install (c);
+    player = new TraceMobilityPlayer (mobilityTrace, c);
+    player -> Start ();
+  }
+  else
+  {
+    MobilityHelper mobility;
+    char rho[50];
+    sprintf(rho, "ns3::UniformRandomVariable[Min=0|Max=%d]",nodeSparseness);
+    Ptr<RandomDiscPositionAllocator> positions = CreateObject<RandomDiscPositionAllocator> ();
+    positions -> SetAttribute ("X", StringValue ("100.0"));
+    positions -> SetAttribute ("Y", StringValue ("100.0"));
+    positions -> SetAttribute ("Rho", StringValue (rho));
+    positions -> AssignStreams (2000000); //the start position streams of simple-adhoc.cc
+    mobility.SetPositionAllocator (positions);
+    char speed[45];
+    sprintf(speed, "ns3::ConstantRandomVariable[Constant=%d]",nodeSpeed);
+    mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
+                               "Bounds", RectangleValue (Rectangle (0-nodeTravel, nodeTravel, 0-nodeTravel, nodeTravel)),
+                               "Distance", DoubleValue (1.0),
+                               "Speed", StringValue (speed));
+    mobility.Install (c);
+    MobilityHelper::AssignStreams (c, 1);
+  }
+
+  ContactSampler sampler (c, step, contacts);
+  Simulator::Schedule (Seconds (0), &ContactSampler::Sample, &sampler);
+  Simulator::Stop (Seconds (duration));
+  Simulator::Run ();
+  sampler.Finish ();
+  Simulator::Destroy ();
+  delete player;
+  return true;
+}
+
+/*
+* TraceNode is what MyReceiver keeps for the protocol: its encounter list,
+* the halves it has matched and the packets it has forwarded, plus the
+* nodes it is in contact with right now.
+*/
+class TraceNode
+{
+public:
+  TraceNode (int nodeSize, Time validPeriod, Time matchWindow, Time dupWindow);
+  ~TraceNode ();
+  EncounterList *list;
+  MatchTable matches;
+  SeenCache seen;
+  NeighborSet neighbors; //filled by calculateMaxScore
+  std::vector<uint32_t> contacts;
+  bool isMalicious;
+private:
+  TraceNode (const TraceNode &);
+  TraceNode &operator= (const TraceNode &);
+};
+
+TraceNode::TraceNode (int nodeSize, Time validPeriod, Time matchWindow, Time dupWindow)
+  : matches(matchWindow),
+    seen(dupWindow),
+    neighbors(nodeSize)
+{
+  this -> list = new EncounterList(nodeSize, 1/2.0, exp (-4), validPeriod);
+  this -> isMalicious = false;
+}
+
+TraceNode::~TraceNode ()
+{
+  delete this -> list;
+}
+
+/*
+* TraceEngine is the discrete event loop. Events are kept in a binary heap
+* ordered by time, then by the order they were scheduled in.
+*/
+class TraceEngine
+{
+public:
+  enum Kind { CONTACT_UP, CONTACT_DOWN, HELLO_ROUND, SEND_MESSAGE, SEND_KEY, DELIVER };
+  TraceEngine (int nodeSize, double threshold, Time validPeriod, Time matchWindow, Time dupWindow,
+               Time beaconPeriod, Time hopDelay);
+  ~TraceEngine ();
+  void AddContacts (const std::vector<Contact> &contacts);
+  void PickMalicious (double maliRatio);
+  void StartSource (uint32_t source, Time messageInterval, Time keyInterval);
+  void Run (Time stop);
+  void Report (const std::string &metricsName, Time metricsStep);
+private:
+  struct Event
+  {
+    int64_t time; //nanoseconds
+    uint64_t order;
+    uint8_t kind;
+    uint32_t a; //a node of a contact, the sender otherwise
+    uint32_t b; //the other node of a contact, the broadcast of a delivery
+    bool operator< (const Event &other) const
+    {
+      //std::priority_queue pops the largest, so the earliest event compares largest
+      return time != other.time ? time > other.time : order > other.order;
+    }
+  };
+  struct Broadcast
+  {
+    uint8_t half;
+    uint32_t key;
+    uint32_t target; //ANY_NODE or the receiver; ignored with recipients
+    std::vector<uint32_t> recipients; //sorted
+  };
+  void Schedule (int64_t time, uint8_t kind, uint32_t a, uint32_t b);
+  void SendHalf (uint32_t sender, uint8_t half, uint32_t key, uint32_t target, const std::vector<uint32_t> &recipients);
+  void Deliver (uint32_t sender, const Broadcast &broadcast);
+  void Receive (uint32_t id, const Broadcast &broadcast);
+  static void Unlink (std::vector<uint32_t> &contacts, uint32_t id);
+  int nodeSize;
+  double threshold;
+  int64_t beaconPeriod;
+  int64_t hopDelay;
+  int64_t now;
+  uint64_t scheduled;
+  std::priority_queue<Event> events;
+  std::vector<TraceNode*> nodes;
+  std::vector<Broadcast> broadcasts; //in flight, by the DELIVER event that carries them
+  std::vector<uint32_t> freeBroadcasts; //delivered slots of broadcasts
+  //the source
+  uint32_t source;
+  int64_t messageInterval;
+  int64_t keyInterval;
+  uint32_t currentKeyNum;
+  //results
+  uint32_t totalSent;
+  uint64_t contactsReplayed;
+  uint64_t forwards;
+  DecodeAccounting decodes;
+  MetricsCollector metrics;
+};
+
+TraceEngine::TraceEngine (int nodeSize, double threshold, Time validPeriod, Time matchWindow, Time dupWindow,
+                          Time beaconPeriod, Time hopDelay)
+{
+  this -> nodeSize = nodeSize;
+  this -> threshold = threshold;
+  this -> beaconPeriod = beaconPeriod.GetNanoSeconds ();
+  this -> hopDelay = hopDelay.GetNanoSeconds ();
+  this -> now = 0;
+  this -> scheduled = 0;
+  this -> source = 0;
+  this -> messageInterval = 0;
+  this -> keyInterval = 0;
+  this -> currentKeyNum = 1;
+  this -> totalSent = 0;
+  this -> contactsReplayed = 0;
+  this -> forwards = 0;
+  this -> metrics.SetNodeCount (nodeSize);
+  for (int i = 0; i < nodeSize; i++)
+    nodes.push_back (new TraceNode (nodeSize, validPeriod, matchWindow, dupWindow));
+  //the BeaconScheduler of simple-adhoc.cc starts at 0.1 s
+  Schedule (MilliSeconds (100).GetNanoSeconds (), HELLO_ROUND, 0, 0);
+}
+
+TraceEngine::~TraceEngine ()
+{
+  for (uint32_t i = 0; i < nodes.size (); i++)
+    delete nodes[i];
+}
+
+void
+TraceEngine::Schedule (int64_t time, uint8_t kind, uint32_t a, uint32_t b)
+{
+  Event event;
+  event.time = time;
+  event.order = scheduled++;
+  event.kind = kind;
+  event.a = a;
+  event.b = b;
+  events.push (event);
+}
+
+void
+TraceEngine::AddContacts (const std::vector<Contact> &contacts)
+{
+  for (uint32_t i = 0; i < contacts.size (); i++)
+  {
+    const Contact &contact = contacts[i];
+    if (contact.a >= (uint32_t) nodeSize || contact.b >= (uint32_t) nodeSize || contact.a == contact.b)
+      continue;
+    Schedule (Seconds (contact.start).GetNanoSeconds (), CONTACT_UP, contact.a, contact.b);
+    Schedule (Seconds (contact.end).GetNanoSeconds (), CONTACT_DOWN, contact.a, contact.b);
+  }
+}
+
+//pick maliRatio * nodeSize distinct malicious nodes, from the same stream as simple-adhoc.cc
+void
+TraceEngine::PickMalicious (double maliRatio)
+{
+  Ptr<UniformRandomVariable> pick = CreateObject<UniformRandomVariable> ();
+  pick -> SetStream (0);
+  int maliNumber = maliRatio * nodeSize;
+  int maliCount = 0;
+  while (maliCount < maliNumber) {
+    int randIdx = pick -> GetInteger (0, nodeSize - 1);
+    if (!nodes[randIdx] -> isMalicious) {
+      nodes[randIdx] -> isMalicious = true;
+      maliCount++;
+    }
+  }
+}
+
+void
+TraceEngine::StartSource (uint32_t source, Time messageInterval, Time keyInterval)
+{
+  this -> source = source;
+  this -> messageInterval = messageInterval.GetNanoSeconds ();
+  this -> keyInterval = keyInterval.GetNanoSeconds ();
+  Schedule (this -> messageInterval, SEND_MESSAGE, source, 0);
+  Schedule (this -> keyInterval, SEND_KEY, source, 0);
+}
+
+void
+TraceEngine::Unlink (std::vector<uint32_t> &contacts, uint32_t id)
+{
+  std::vector<uint32_t>::iterator it = std::find (contacts.begin (), contacts.end (), id);
+  if (it != contacts.end ())
+  {
+    *it = contacts.back ();
+    contacts.pop_back ();
+  }
+}
+
+void
+TraceEngine::SendHalf (uint32_t sender, uint8_t half, uint32_t key, uint32_t target, const std::vector<uint32_t> &recipients)
+{
+  Broadcast broadcast;
+  broadcast.half = half;
+  broadcast.key = key;
+  broadcast.target = target;
+  broadcast.recipients = recipients;
+  std::sort (broadcast.recipients.begin (), broadcast.recipients.end ());
+  uint32_t slot = broadcasts.size ();
+  if (freeBroadcasts.empty ())
+    broadcasts.push_back (broadcast);
+  else
+  {
+    slot = freeBroadcasts.back ();
+    freeBroadcasts.pop_back ();
+    broadcasts[slot] = broadcast;
+  }
+  Schedule (now + hopDelay, DELIVER, sender, slot);
+}
+
+//every node in contact with the sender when the broadcast arrives hears it
+void
+TraceEngine::Deliver (uint32_t sender, const Broadcast &broadcast)
+{
+  std::vector<uint32_t> receivers = nodes[sender] -> contacts;
+  for (uint32_t i = 0; i < receivers.size (); i++)
+    Receive (receivers[i], broadcast);
+}
+
+//MyReceiver::HandleHalf and MatchHalf without the packet
+void
+TraceEngine::Receive (uint32_t id, const Broadcast &broadcast)
+{
+  TraceNode &node = *nodes[id];
+  Time t = NanoSeconds (now);
+  MatchTable::Half half = (MatchTable::Half) broadcast.half;
+  bool matchFound = node.matches.Match (broadcast.key, half, t);
+  if (matchFound)
+  {
+    metrics.Delivered (broadcast.key, t);
+    decodes.RecordDecode (broadcast.key, node.isMalicious);
+  }
+
+  bool addressedToMe;
+  if (!broadcast.recipients.empty ())
+    addressedToMe = std::binary_search (broadcast.recipients.begin (), broadcast.recipients.end (), id);
+  else
+    addressedToMe = broadcast.target == ANY_NODE || broadcast.target == id;
+  if (!addressedToMe)
+    return;
+
+  uint32_t target = broadcast.recipients.empty () ? broadcast.target : id;
+  if (!matchFound && !node.matches.IsDecoded (broadcast.key) &&
+      !node.seen.CheckAndInsert (broadcast.half, broadcast.key, target, t)) {
+    std::vector<uint32_t> next = node.list -> calculateMaxScore (t, threshold, node.neighbors);
+    if (!next.empty ()) {
+      forwards++;
+      metrics.Forwarded (id);
+      SendHalf (id, broadcast.half, broadcast.key, ANY_NODE, next);
+    }
+  }
+}
+
+void
+TraceEngine::Run (Time stop)
+{
+  int64_t end = stop.GetNanoSeconds ();
+  while (!events.empty () && events.top ().time <= end)
+  {
+    Event event = events.top ();
+    events.pop ();
+    now = event.time;
+    switch (event.kind)
+    {
+    case CONTACT_UP:
+      nodes[event.a] -> contacts.push_back (event.b);
+      nodes[event.b] -> contacts.push_back (event.a);
+      contactsReplayed++;
+      break;
+    case CONTACT_DOWN:
+      Unlink (nodes[event.a] -> contacts, event.b);
+      Unlink (nodes[event.b] -> contacts, event.a);
+      break;
+    case HELLO_ROUND:
+      //every node hears one hello from each node it is in contact with
+      for (uint32_t i = 0; i < nodes.size (); i++)
+        for (uint32_t j = 0; j < nodes[i] -> contacts.size (); j++)
+          nodes[i] -> list -> InsertItem (nodes[i] -> contacts[j], NanoSeconds (now));
+      Schedule (now + beaconPeriod, HELLO_ROUND, 0, 0);
+      break;
+    case SEND_MESSAGE:
+      metrics.MessageSent (currentKeyNum, NanoSeconds (now));
+      SendHalf (source, MatchTable::MESSAGE, currentKeyNum, ANY_NODE, std::vector<uint32_t> ());
+      Schedule (now + messageInterval, SEND_MESSAGE, source, 0);
+      break;
+    case SEND_KEY:
+      metrics.KeySent (currentKeyNum, NanoSeconds (now));
+      SendHalf (source, MatchTable::KEY, currentKeyNum, ANY_NODE, std::vector<uint32_t> ());
+      totalSent = currentKeyNum;
+      currentKeyNum++;
+      Schedule (now + keyInterval, SEND_KEY, source, 0);
+      break;
+    case DELIVER:
+      {
+        //a copy, as the receivers may send broadcasts of their own
+        Broadcast broadcast = broadcasts[event.b];
+        freeBroadcasts.push_back (event.b);
+        Deliver (event.a, broadcast);
+      }
+      break;
+    }
+  }
+  now = std::max (now, end); //the clock ends at the stop time, like Simulator::Stop
+}
+
+void
+TraceEngine::Report (const std::string &metricsName, Time metricsStep)
+{
+  std::cout << "Contacts Replayed: " << contactsReplayed << std::endl;
+  std::cout << "Total Number of Messages Sent: " << totalSent << std::endl;
+  std::cout << "Total Number of Messages Decoded: " << decodes.GetTotalCount () << std::endl;
+  std::cout << "Total Number of Messages Decoded by Malicious: " << decodes.GetMaliciousCount () << std::endl;
+  LatencyHistogram &latency = metrics.GetLatency ();
+  std::cout << "Average Message Delay in milliseconds: " << latency.GetMean () / 1000.0 << std::endl;
+  std::cout << "Message Delay p50/p99/max in milliseconds: " << latency.GetPercentile (50) / 1000.0 << " / "
+            << latency.GetPercentile (99) / 1000.0 << " / " << latency.GetMax () / 1000.0 << std::endl;
+  std::cout << "Total Number of Forwards: " << forwards << std::endl;
+  if (!metricsName.empty () && !metrics.Write (metricsName, Seconds (0), NanoSeconds (now), metricsStep))
+    std::cerr << "cannot write " << metricsName << std::endl;
+}
+
+int main (int argc, char *argv[])
+{
+  std::string traceName = "";
+  std::string generateName = "";
+  std::string mobilityName = "";
+  int nodeSize = 50;
+  int nodeSparseness = 30;
+  int nodeTravel = 300;
+  int nodeSpeed = 100;
+  double sampleStep = 0.1;
+  double maliRatio = 0.5;
+  double threshold = 1.0;
+  double validPeriod = 20.0;
+  uint64_t matchWindow = 1500;
+  uint64_t dupWindow = 1000;
+  int movingDelay = 3;
+  int sourceNode = 2;
+  double beaconPeriod = 1.0;
+  double hopDelay = 1.0;
+  double simulationTime = 55.0;
+  std::string metricsName = "";
+  double metricsStep = 1.0;
+  CommandLine cmd;
+  cmd.AddValue ("trace", "contact trace to replay", traceName);
+  cmd.AddValue ("generate", "sample the random walk of simple-adhoc.cc into this contact trace, then replay it", generateName);
+  cmd.AddValue ("mobility", "generate the contacts from this binary mobility trace instead of a random walk", mobilityName);
+  cmd.AddValue ("nodeSize", "number of nodes (default 50)", nodeSize);
+  cmd.AddValue ("nodeSparseness", "density of the generated network (default 30)", nodeSparseness);
+  cmd.AddValue ("nodeTravel", "how far a generated node will travel (default 300)", nodeTravel);
+  cmd.AddValue ("nodeSpeed", "speed of each generated node (default 100)", nodeSpeed);
+  cmd.AddValue ("sampleStep", "seconds between the position samples of a generated trace (default 0.1)", sampleStep);
+  cmd.AddValue ("maliRatio", "percentage of malicious nodes (default 0.5)", maliRatio);
+  cmd.AddValue ("threshold", "threshold for every node to broadcast (default 1.0)", threshold);
+  cmd.AddValue ("validPeriod", "seconds an encounter is kept in the encounter list (default 20)", validPeriod);
+  cmd.AddValue ("matchWindow", "milliseconds a message and its key can be apart and still match (default 1500)", matchWindow);
+  cmd.AddValue ("dupWindow", "milliseconds a node will not forward the same packet again (default 1000)", dupWindow);
+  cmd.AddValue ("delay", "the time period between sending message and key (default 3)", movingDelay);
+  cmd.AddValue ("sourceNode", "the node chosen to be the source (default 2)", sourceNode);
+  cmd.AddValue ("beaconPeriod", "seconds between hello rounds (default 1)", beaconPeriod);
+  cmd.AddValue ("hopDelay", "milliseconds a broadcast takes to arrive (default 1)", hopDelay);
+  cmd.AddValue ("simulationTime", "seconds to replay (default 55)", simulationTime);
+  cmd.AddValue ("metrics", "file the delay histogram, forwards per node and delivery over time are written to, CSV if it ends in .csv", metricsName);
+  cmd.AddValue ("metricsStep", "seconds between the points of the delivery ratio over time (default 1)", metricsStep);
+  cmd.Parse (argc, argv);
+
+  if (sourceNode < 0 || sourceNode >= nodeSize)
+  {
+    std::cerr << "sourceNode " << sourceNode << " is not one of the " << nodeSize << " nodes" << std::endl;
+    return 1;
+  }
+
+  std::vector<Contact> contacts;
+  if (!generateName.empty ())
+  {
+    if (!GenerateContacts (nodeSize, nodeSparseness, nodeTravel, nodeSpeed, simulationTime, Seconds (sampleStep),
+                           mobilityName, contacts))
+      return 1;
+    if (!WriteContacts (generateName, contacts, nodeSize))
+    {
+      std::cerr << "cannot write " << generateName << std::endl;
+      return 1;
+    }
+  }
+  else if (traceName.empty ())
+  {
+    std::cerr << "give a contact trace with --trace or generate one with --generate" << std::endl;
+    return 1;
+  }
+  else if (!ReadContacts (traceName, contacts))
+    return 1;
+
+  TraceEngine engine (nodeSize, threshold, Seconds (validPeriod), MilliSeconds (matchWindow), MilliSeconds (dupWindow),
+                      Seconds (beaconPeriod), MicroSeconds (hopDelay * 1000));
+  engine.AddContacts (contacts);
+  engine.PickMalicious (maliRatio);
+  engine.StartSource (sourceNode, Seconds (0.321), Seconds (0.321 + movingDelay));
+  engine.Run (Seconds (simulationTime));
+  engine.Report (metricsName, Seconds (metricsStep));
+  return 0;
+}